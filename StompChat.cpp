@@ -3,8 +3,8 @@
 #include <gtk/gtk.h>
 #include <thread>
 #include <sstream>
-#include <regex>
 #include "StompClient.h"
+#include "StompGlib.h"
 using std::string;
 
 // These are global so that they are easily accessible from the "sendText" callback.
@@ -15,33 +15,35 @@ StompClient    stompy;
 
 
 
-void onMessage( string message )
+// This runs on the GTK thread, with every message that has come in since it
+// last ran.
+void onMessages( std::vector<StompMessage>& messages, void* context )
 {
-  // Parse the JSON apart to get the message
-  // The message is of the form
+  // Pull each message out of its JSON. The message is of the form
   /*
   { "message" : "message body" }
   */
 
-  const char* messageText;
-  std::regex  messageRegex("^.*:[[:space:]]*\"(.*)\".*$");
-  std::smatch messageMatcher;
+  std::string text;
   std::string messageBody;
-  if( std::regex_search( message, messageMatcher, messageRegex ))
+  for( const StompMessage& message : messages )
   {
-    messageBody = messageMatcher[1];
-    std::cout << "From regex, message body is " << messageBody << std::endl;
-    messageText = messageBody.c_str();
-  }
-  else
-  {
-    messageText = message.c_str();
+    const StompFrame& frame = message.frame();
+    if( frame.json().getString( "message", messageBody ) )
+    {
+      text += messageBody;
+    }
+    else
+    {
+      text += frame.body;
+    }
+    text += '\n';
   }
 
-  g_print( "Got text from server: %s\n", messageText );
+  g_print( "Got %zu messages from server\n", messages.size() );
 
-  gtk_text_buffer_insert( buffer, &iter, messageText, -1 );
-  gtk_text_buffer_insert( buffer, &iter, "\n",        -1 );
+  // One insert for the lot
+  gtk_text_buffer_insert( buffer, &iter, text.c_str(), text.size() );
 }
 
 // Send text to the server
@@ -96,6 +98,10 @@ int main( int argc, char *argv[] )
   // Initialize the application
   gtk_init( &argc, &argv );
 
+  // Messages come in on the client's own thread, so this passes them over
+  // to the GTK thread.
+  StompGlibDispatcher dispatcher( onMessages, NULL );
+
   // Create the window and set its size.
   window = gtk_window_new( GTK_WINDOW_TOPLEVEL );
   gtk_window_set_position( GTK_WINDOW( window ), GTK_WIN_POS_CENTER );
@@ -132,7 +138,7 @@ int main( int argc, char *argv[] )
 
   // Open the STOMP connection
   stompy.connect( "172.16.2.31", "8080", "/stomp-server", NULL, NULL );
-  stompy.setMessageHandler( onMessage );
+  stompy.setFrameHandler( StompGlibDispatcher::queueFrame, &dispatcher );
 
   // Subscribe our topic
   stompy.subscribe( 147, "/topic/topic1", "auto" );
@@ -143,6 +149,11 @@ int main( int argc, char *argv[] )
   // Start the GTK part of the application.
   gtk_main();
 
+  // The dispatcher goes with main, so wait for the io thread to finish
+  // before it does: nothing can be handed to it after that.
+  stompy.close();
+  stompy.synchronize();
+
   return 0;
 }
 
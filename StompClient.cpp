@@ -1,7 +1,10 @@
 #include "StompClient.h"
 #include "WebSocketSession.h"
 #include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <random>
 using std::string;
 
 // We use this method to remove '\r' from the end of strings
@@ -14,196 +17,1281 @@ static inline void rtrim( std::string & s)
 			 }).base(), s.end() );
 }
 
+// Read a number out of a header
+template< class Number >
+static bool headerNumber( std::string_view value, Number& number )
+{
+  auto parsed = std::from_chars( value.data(), value.data() + value.size(), number );
+  return !value.empty() && parsed.ec == std::errc();
+}
+
 // This is the error callback for right now
-void fail( beast::error_code ec, char const* module )
+template< class Logger >
+static void fail( beast::error_code ec, char const* module )
 {
-  std::cerr << module << ": " << ec.message() << std::endl;
+  Logger::error( module, ": ", ec.message() );
 }
 
 
-void StompClient::setMessageHandler( void (*handler)(string body) )
+template< class Policies >
+void BasicStompClient<Policies>::setTransport( StompTransportType type )
+{
+  transportType = type;
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setSocketOptions( const StompSocketOptions& options )
+{
+  socketOptions = options;
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setRunMode( StompRunMode mode, int cpu )
+{
+  runMode = mode;
+  runCpu  = cpu;
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setMessageHandler( void (*handler)(string body) )
 {
   messageHandler = handler;
 }
 
-void StompClient::onRead( char const *message )
+template< class Policies >
+void BasicStompClient<Policies>::setFrameHandler( Handler handler, void* context )
 {
-  //std::cout << "Received message:\n" << message << std::endl;
+  defaultFrameHandler = std::move( handler );
+  defaultFrameContext = context;
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setStreamHandler( chunkHandler handler, void* context, std::size_t threshold )
+{
+  streamHandler   = handler;
+  streamContext   = context;
+  streamThreshold = threshold;
+}
 
-  std::string messageText = message;
-  std::istringstream messageStream( messageText );
-  std::string messageType;
+template< class Policies >
+void BasicStompClient<Policies>::setReadMessageMax( std::size_t bytes )
+{
+  readMessageMax = bytes;
+}
 
-  // Note that the std::getline method used here will leave any '\r'
-  // intact at the end of the line, so ...
-  std::getline( messageStream, messageType );
+template< class Policies >
+void BasicStompClient<Policies>::setFrameArenaSize( std::size_t size )
+{
+  frameArenaSize = size;
+}
 
-  // ... we have to remove them here.
-  rtrim( messageType );
-  //std::cout << "Message type is " << messageType << "|" << std:: endl;
-  
-  std::string header;
-  std::map<string,string> headers;
-  while( std::getline( messageStream, header ) )
+template< class Policies >
+void BasicStompClient<Policies>::onRead( char *message, std::size_t length )
+{
+  //std::cout << "Received message:\n" << message << std::endl;
+
+  // Anything the frame allocates comes out of the arena, which is reset as
+  // soon as the frame has been dispatched.
   {
-    rtrim( header );
-    if( header.length() == 0 )
+    // Split the frame apart, unescaping the headers as we go.
+    StompFrame frame( frameMemory.resource() );
+    if( parseFrame( message, length, version, frame ) )
     {
-      break;
+      dispatchFrame( frame );
+    }
+    else
+    {
+      Logger::info( "Discarding malformed frame" );
     }
-
-    // Parse the header into an attribute-value pair
-    size_t colonIndex = header.find( ":" );
-    std::string attribute = header.substr( 0, colonIndex );
-    std::string value     = header.substr( colonIndex + 1 );
-    headers[ attribute ] = value;
   }
+  frameMemory.release();
+}
 
-  // Get the body, if any
-  std::string body;
-  std::getline( messageStream, body );
-  rtrim( body );
+// Bytes straight off the connection, once we are streaming
+template< class Policies >
+void BasicStompClient<Policies>::onReadSome( char* data, std::size_t length )
+{
+  streamReader->feed( data, length, version );
+}
+
+// Act on a received frame
+template< class Policies >
+void BasicStompClient<Policies>::dispatchFrame( const StompFrame& frame )
+{
+  std::string_view messageType = frame.command;
+  //std::cout << "Message type is " << messageType << "|" << std:: endl;
  
   if( messageType == "CONNECTED" )
   {
     //std::cout << "Connected!" << std::endl;
+
+    // A server that leaves out the version header is speaking 1.0.
+    if( !frame.has( HEADER_VERSION ) )
+    {
+      version = STOMP_1_0;
+    }
+    else if( frame.header( HEADER_VERSION ) == "1.2" )
+    {
+      version = STOMP_1_2;
+    }
+    else
+    {
+      version = STOMP_1_1;
+    }
+
+    // From here on, big frames are streamed if we have been asked to.
+    if( streamReader )
+    {
+      currentSession->setStreaming( true );
+    }
+
+    // Now send anything that piled up while we were away.
+    stompConnected = true;
+    drainJournal();
   }
   else if( messageType == "MESSAGE" )
   {
-    std::cout << "Received Message: " << body << std::endl;
-    
-    // Invoke the message handler, if any.
-    if( messageHandler != NULL )
+    Logger::info( "Received Message: ", frame.body );
+
+    // Anything we have already seen goes no further.
+    if( isRedelivery( frame ) )
     {
-      messageHandler( body );
+      return;
     }
-     
-    // Release the thread lock
-    std::unique_lock<std::mutex> locker( g_message );
-    g_messagecheck.notify_one();
+
+    // Time the message, if it is stamped and we are timing.
+    if( latencyTracking && frame.has( HEADER_STOMP_TIMESTAMP ) )
+    {
+      trackLatency( frame );
+    }
+
+    // Pieces of a larger message wait for the rest of it.
+    if( frame.has( HEADER_SUBSCRIPTION ) && frame.header( std::string_view( "fragment-id" ) ).data() != NULL )
+    {
+      reassemble( frame );
+      return;
+    }
+
+    deliverMessage( frame );
   }
   else if( messageType == "ERROR" )
   {
-    std::cout << "Error! " << body << std::endl;
+    Logger::info( "Error! ", frame.body );
   }
   else if( messageType == "RECEIPT" )
   {
-    std::cout << "Received receipt for " << headers[ "receipt-id" ] << std::endl;
+    Logger::info( "Received receipt for ", frame.header( HEADER_RECEIPT_ID ) );
 							      
     // Release the thread lock
-    std::unique_lock<std::mutex> locker( g_receipt );
+    std::unique_lock<Mutex> locker( g_receipt );
     g_receiptcheck.notify_one();
   }
   
 }
 
+// Hand a MESSAGE to whoever wants it
+template< class Policies >
+void BasicStompClient<Policies>::deliverMessage( const StompFrame& frame )
+{
+  // Hand the frame to the handler for its subscription, if it has one, or
+  // else to the default frame handler.
+  if( !dispatchToSubscription( frame ) && !Handlers::empty( defaultFrameHandler ) )
+  {
+    Handlers::call( defaultFrameHandler, frame, defaultFrameContext );
+  }
+
+  // Invoke the message handler, if any. It gets the body without its
+  // trailing EOL.
+  if( messageHandler != NULL )
+  {
+    std::string body( frame.body );
+    rtrim( body );
+    messageHandler( body );
+  }
+   
+  // Release the thread lock
+  std::unique_lock<Mutex> locker( g_message );
+  g_messagecheck.notify_one();
+}
+
+// Put a fragmented message back together, handing it on once the last
+// fragment is in. The fragments come in order, so a gap means one has been
+// lost, and the message with it.
+template< class Policies >
+void BasicStompClient<Policies>::reassemble( const StompFrame& fragment )
+{
+  std::size_t index = 0;
+  std::size_t count = 0;
+  if( !headerNumber( fragment.header( std::string_view( "fragment-index" ) ), index ) ||
+      !headerNumber( fragment.header( std::string_view( "fragment-count" ) ), count ) || index >= count )
+  {
+    Logger::info( "Discarding malformed fragment" );
+    return;
+  }
+
+  string key( fragment.header( HEADER_SUBSCRIPTION ) );
+  key += '/';
+  key += fragment.header( std::string_view( "fragment-id" ) );
+
+  auto now = std::chrono::steady_clock::now();
+  if( index == 0 && reassemblies.find( key ) == reassemblies.end() )
+  {
+    makeRoomForReassembly( now );
+  }
+  Reassembly& reassembly = reassemblies[ key ];
+  if( index == 0 )
+  {
+    reassembly.body.clear();
+    reassembly.next    = 0;
+    reassembly.started = now;
+  }
+  if( index != reassembly.next )
+  {
+    Logger::info( "Missing fragment ", reassembly.next, " of ", key, ": dropping message" );
+    reassemblies.erase( key );
+    return;
+  }
+  reassembly.body.append( fragment.body.data(), fragment.body.size() );
+  if( readMessageMax > 0 && reassembly.body.size() > readMessageMax )
+  {
+    Logger::info( "Fragmented message ", key, " is too big: dropping message" );
+    reassemblies.erase( key );
+    return;
+  }
+  if( ++reassembly.next < count )
+  {
+    return;
+  }
+
+  // The whole message has the last fragment's headers, less the fragment
+  // ones and the content-length.
+  string     body = std::move( reassembly.body );
+  StompFrame whole( frameMemory.resource() );
+  reassemblies.erase( key );
+
+  whole.command = fragment.command;
+  whole.body    = body;
+  std::copy( fragment.known, fragment.known + HEADER_COUNT, whole.known );
+  whole.known[ HEADER_CONTENT_LENGTH ] = std::string_view();
+  for( const auto& header : fragment.custom )
+  {
+    if( header.first.substr( 0, 9 ) != "fragment-" )
+    {
+      whole.custom.push_back( header );
+    }
+  }
+  deliverMessage( whole );
+}
+
+// Drop the reassemblies that have stalled, and if that does not leave room
+// for another, the oldest.
+template< class Policies >
+void BasicStompClient<Policies>::makeRoomForReassembly( std::chrono::steady_clock::time_point now )
+{
+  auto oldest = reassemblies.end();
+  for( auto entry = reassemblies.begin(); entry != reassemblies.end(); )
+  {
+    if( now - entry->second.started > REASSEMBLY_TIMEOUT )
+    {
+      Logger::info( "Fragmented message ", entry->first, " timed out: dropping message" );
+      entry = reassemblies.erase( entry );
+      continue;
+    }
+    if( oldest == reassemblies.end() || entry->second.started < oldest->second.started )
+    {
+      oldest = entry;
+    }
+    ++entry;
+  }
+
+  if( reassemblies.size() >= MAX_REASSEMBLIES && oldest != reassemblies.end() )
+  {
+    Logger::info( "Too many fragmented messages: dropping ", oldest->first );
+    reassemblies.erase( oldest );
+  }
+}
+
+// Drop the partial messages on a subscription that has gone.
+template< class Policies >
+void BasicStompClient<Policies>::dropReassemblies( int id )
+{
+  string prefix = std::to_string( id );
+  prefix += '/';
+  for( auto entry = reassemblies.begin(); entry != reassemblies.end(); )
+  {
+    if( entry->first.compare( 0, prefix.size(), prefix ) == 0 )
+    {
+      entry = reassemblies.erase( entry );
+    }
+    else
+    {
+      ++entry;
+    }
+  }
+}
+
+// Read the subscription id a message was delivered on.
+static bool subscriptionId( const StompFrame& frame, int& id )
+{
+  std::string_view subscription = frame.header( HEADER_SUBSCRIPTION );
+  auto parsed = std::from_chars( subscription.data(), subscription.data() + subscription.size(), id );
+  return !subscription.empty() && parsed.ec == std::errc();
+}
+
+// Find the handler registered for the frame's subscription and call it.
+// Returns false if there isn't one.
+template< class Policies >
+bool BasicStompClient<Policies>::dispatchToSubscription( const StompFrame& frame )
+{
+  int id = 0;
+  if( !subscriptionId( frame, id ) )
+  {
+    return false;
+  }
+
+  Handler handler;
+  void   *context;
+  {
+    std::unique_lock<Mutex> locker( g_subscriptions );
+    auto found = subscriptions.find( id );
+    if( found == subscriptions.end() || Handlers::empty( found->second.handler ) )
+    {
+      return false;
+    }
+    handler = found->second.handler;
+    context = found->second.context;
+
+    // Queued under the lock, so the io thread never holds on to a conflating
+    // queue: the last of it goes wherever it is unsubscribed or replaced, and
+    // waiting there for its handler never holds up reads.
+    if constexpr( std::is_same<Handler, frameHandler>::value )
+    {
+      if( found->second.conflation )
+      {
+	found->second.conflation->push( frame, handler, context );
+	return true;
+      }
+    }
+  }
+
+  Handlers::call( handler, frame, context );
+  return true;
+}
+
+// Check a message against its subscription's deduplication window, if it has
+// one. Repeats on "client-individual" subscriptions are acknowledged here so
+// the broker stops sending them. Under "client" an ACK is cumulative, so
+// acknowledging an old repeat would acknowledge newer messages the handler
+// has not seen yet; those repeats are just dropped.
+template< class Policies >
+bool BasicStompClient<Policies>::isRedelivery( const StompFrame& frame )
+{
+  int id = 0;
+  if( !frame.has( HEADER_MESSAGE_ID ) || !subscriptionId( frame, id ) )
+  {
+    return false;
+  }
+
+  bool acknowledge;
+  {
+    std::unique_lock<Mutex> locker( g_subscriptions );
+    auto found = subscriptions.find( id );
+    if( found == subscriptions.end() || !found->second.dedup ||
+	!found->second.dedup->checkAndInsert( frame.header( HEADER_MESSAGE_ID ) ) )
+    {
+      return false;
+    }
+    acknowledge = found->second.individualAck;
+  }
+
+  Logger::info( "Dropping redelivered message ", frame.header( HEADER_MESSAGE_ID ) );
+  if( acknowledge )
+  {
+    ack( frame );
+  }
+  return true;
+}
+
 // This is what we use for the "End-of-Line" character. Note that the '\r' is
 // optional, but that if it is used, it must come before the '\n'.
-const char* StompClient::EOL = "\r\n";
+template< class Policies >
+const char* BasicStompClient<Policies>::EOL = "\r\n";
+
+// Every frame ends with a NUL, and we follow that with an EOL.
+template< class Policies >
+const char BasicStompClient<Policies>::TERMINATOR[ 2 ] = { '\0', '\n' };
 
-void StompClient::connect( const char* host, const char *port, const char* path, const char *login, const char *passcode )
+template< class Policies >
+bool BasicStompClient<Policies>::connect( const char* host, const char *port, const char* path, const char *login, const char *passcode )
 {
-  // This is a new connection so set the message handler to NULL.
-  messageHandler = NULL;
+  return connect( { StompEndpoint{ host, port, path } }, login, passcode );
+}
+
+template< class Policies >
+bool BasicStompClient<Policies>::connect( const std::vector<StompEndpoint>& endpoints, const char *login, const char *passcode,
+			   std::chrono::milliseconds timeout, std::chrono::milliseconds stagger )
+{
+  // Whatever is left of the last connection has to go first, and anything
+  // it did not get round to writing from the journal goes again.
+  shutdownConnection();
+  {
+    std::unique_lock<Mutex> locker( g_journal );
+    spillJournal.rewind();
+  }
+  reassemblies.clear();
+
+  // This is a new connection so set the message handler to NULL and
+  // escape headers the 1.1 way until the server tells us its version.
+  messageHandler      = NULL;
+  defaultFrameHandler = Handler();
+  defaultFrameContext = NULL;
+  version             = STOMP_1_1;
+  stompConnected      = false;
+
+  if( endpoints.empty() )
+  {
+    return false;
+  }
   
-  // Create the WebSocket session
+  // Set up the memory received frames are parsed into.
+  frameMemory.reset( frameArenaSize );
+
+  // And the reader that cuts the stream into frames, if we are streaming.
+  streamReader.reset( streamHandler != NULL ? new StompStreamReader( *this, streamHandler, streamContext, streamThreshold ) : NULL );
+
+  // Create a session for each broker, using whichever transport we are using
   ioc = new net::io_context();
-  
-  currentSession = std::make_shared<session>( *ioc, fail, this );
+  staggerTimer.reset( new net::steady_timer( *ioc ) );
+  {
+    std::unique_lock<Mutex> locker( g_calls );
+    callTimer.reset( new net::steady_timer( *ioc ) );
+    callTimerRunning = false;
+    replySubscribed  = false;
+  }
+  connectStagger = stagger;
 
-  // Set the various parameters
-  currentSession->run( host, port, path );
+  {
+    std::unique_lock<Mutex> locker( g_connected );
+    attempts.clear();
+    for( const StompEndpoint& endpoint : endpoints )
+    {
+      std::unique_ptr<ConnectAttempt> attempt( new ConnectAttempt );
+      attempt->client   = this;
+      attempt->endpoint = endpoint;
+      switch( transportType )
+      {
+      case STOMP_OVER_TCP:
+	attempt->session = std::make_shared<tcpsession>( *ioc, fail<Logger>, attempt.get() );
+	break;
+      case STOMP_OVER_UNIX:
+	attempt->session = std::make_shared<unixsession>( *ioc, fail<Logger>, attempt.get() );
+	break;
+      default:
+	attempt->session = std::make_shared<session>( *ioc, fail<Logger>, attempt.get() );
+	break;
+      }
+      attempt->session->setSocketOptions( socketOptions );
+      attempt->session->setReadMessageMax( readMessageMax );
 
-  // Now start the session running in its own thread
-  auto iocRunner = []( net::io_context *ioc )
+      // Create the connection frame, ready for when the transport is up
+      makeConnectFrame( attempt->connectFrame, "1.1,1.2", endpoint.host.c_str(), login, passcode );
+      attempts.push_back( std::move( attempt ) );
+    }
+    attemptsStarted = 0;
+    attemptsFailed  = 0;
+    winner          = NULL;
+    connecting      = true;
+  }
+
+  // Until someone wins, anything sent waits on the first broker's queue.
+  currentSession = attempts.front()->session;
+  startNextAttempt();
+
+  // Now start the sessions running, on a thread of their own unless the
+  // executor runs them on ours
+  executor.template start<Logger>( *ioc, runMode, runCpu );
+
+  // Now we need to wait until a broker has said yes, or they all have said no
+  std::unique_lock<Mutex> locker( g_connected );
+  executor.waitFor( locker, g_connectedcheck, timeout, [this]()
+		    {
+		      return stompConnected || attemptsFailed == attempts.size();
+		    });
+  connecting = false;
+  if( stompConnected )
   {
-    ioc->run();
-    std::cout << "IOCRunner: exiting" << std::endl;
-  };
+    return true;
+  }
+  locker.unlock();
 
-  iocRunnerThread = new std::thread( iocRunner, ioc );
+  // Give up on all of them.
+  Logger::info( "Could not connect to any broker" );
+  executor.stop();
+  return false;
+}
 
-  // Now we need to wait until the connection is ready
-  std::unique_lock<std::mutex> locker( currentSession->g_connection );
-  currentSession->g_connectioncheck.wait( locker );
+template< class Policies >
+BasicStompClient<Policies>::~BasicStompClient()
+{
+  shutdownConnection();
+}
+
+// Tear down the last connection: its sessions, its timers and its
+// io_context. The sessions hold pointers to their attempts, so the
+// io_context is stopped, and its thread joined, before anything goes.
+template< class Policies >
+void BasicStompClient<Policies>::shutdownConnection()
+{
+  if( ioc == NULL )
+  {
+    return;
+  }
+
+  {
+    std::unique_lock<Mutex> locker( g_connected );
+    connecting = false;
+    for( const auto& attempt : attempts )
+    {
+      attempt->session->abort();
+    }
+  }
+  executor.stop();
 
-  // Create the connection frame
-  string connectFrame = makeConnectFrame( "1.1", host, login, passcode );
+  staggerTimer.reset();
+  {
+    std::unique_lock<Mutex> locker( g_calls );
+    callTimer.reset();
+    callTimerRunning = false;
+  }
+  failCalls();
+  currentSession.reset();
+  {
+    std::unique_lock<Mutex> locker( g_connected );
+    attempts.clear();
+    winner = NULL;
+  }
 
-  // Send the connection frame
-  currentSession->send( connectFrame.c_str() );
+  // Anything still queued on the io_context goes with it, the sessions
+  // included.
+  delete ioc;
+  ioc = NULL;
 }
 
+// Start the next connection attempt, if there is one left, and set the timer
+// for the one after that.
+template< class Policies >
+void BasicStompClient<Policies>::startNextAttempt()
+{
+  ConnectAttempt* attempt;
+  {
+    std::unique_lock<Mutex> locker( g_connected );
+    if( !connecting || winner != NULL || attemptsStarted == attempts.size() )
+    {
+      return;
+    }
+    attempt = attempts[ attemptsStarted++ ].get();
+  }
+
+  const StompEndpoint& endpoint = attempt->endpoint;
+  attempt->session->run( endpoint.host.c_str(), endpoint.port.c_str(), endpoint.path.c_str() );
+
+  staggerTimer->expires_after( connectStagger );
+  staggerTimer->async_wait( [this]( beast::error_code ec )
+			    {
+			      if( !ec )
+			      {
+				startNextAttempt();
+			      }
+			    });
+}
+
+// An attempt's transport is up, so ask its broker for a STOMP session.
+template< class Policies >
+void BasicStompClient<Policies>::attemptConnected( ConnectAttempt* attempt )
+{
+  string connectFrame = attempt->session->acquireBuffer();
+  connectFrame += attempt->connectFrame;
+  attempt->session->send( std::move( connectFrame ) );
+}
+
+// A frame has come in on one of the attempts. The first CONNECTED wins the
+// race; anything else before that means the broker has turned us down.
+template< class Policies >
+void BasicStompClient<Policies>::attemptRead( ConnectAttempt* attempt, char* message, std::size_t length )
+{
+  bool won = false;
+  {
+    std::unique_lock<Mutex> locker( g_connected );
+    if( winner == NULL )
+    {
+      std::string_view text( message, length );
+      text.remove_prefix( std::min( text.find_first_not_of( "\r\n" ), text.size() ) );
+      if( !connecting || text.substr( 0, 9 ) != "CONNECTED" )
+      {
+	locker.unlock();
+	Logger::info( "Broker ", attempt->endpoint.host, ":", attempt->endpoint.port, " did not accept the connection" );
+	attempt->session->abort();
+	attemptFailed( attempt );
+	return;
+      }
+      winner         = attempt;
+      currentSession = attempt->session;
+      won            = true;
+    }
+    else if( winner != attempt )
+    {
+      return;
+    }
+  }
+
+  // Drop the others, and do not start any more.
+  if( won )
+  {
+    staggerTimer->cancel();
+    for( std::size_t i = 0; i < attemptsStarted; i++ )
+    {
+      if( attempts[ i ].get() != attempt )
+      {
+	attempts[ i ]->session->abort();
+      }
+    }
+  }
+
+  onRead( message, length );
+
+  if( won )
+  {
+    std::unique_lock<Mutex> locker( g_connected );
+    g_connectedcheck.notify_all();
+  }
+}
 
-void StompClient::subscribe( int id, char const *destination, char const* ack )
+// An attempt has failed, or the winner's connection has gone. When an
+// attempt fails the next one is started straight away.
+template< class Policies >
+void BasicStompClient<Policies>::attemptFailed( ConnectAttempt* attempt )
+{
+  {
+    std::unique_lock<Mutex> locker( g_connected );
+    if( attempt == winner )
+    {
+      locker.unlock();
+      onDisconnect();
+      return;
+    }
+    if( attempt->failed )
+    {
+      return;
+    }
+    attempt->failed = true;
+    ++attemptsFailed;
+    g_connectedcheck.notify_all();
+  }
+
+  startNextAttempt();
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::attemptWritable( ConnectAttempt* attempt )
+{
+  {
+    std::unique_lock<Mutex> locker( g_connected );
+    if( attempt != winner )
+    {
+      return;
+    }
+  }
+  onWritable();
+}
+
+
+template< class Policies >
+void BasicStompClient<Policies>::subscribe( int id, char const *destination, char const* ack )
 {
   //std::cout << "Subscribing to id " << id << std::endl;
-  std::string subscribeFrame = makeSubscribeFrame( id, destination, ack );
+  {
+    std::unique_lock<Mutex> locker( g_subscriptions );
+    subscriptions[ id ].individualAck = ack != NULL && strcmp( ack, "client-individual" ) == 0;
+  }
+
+  std::string subscribeFrame = currentSession->acquireBuffer();
+  makeSubscribeFrame( subscribeFrame, id, destination, ack );
+
+  // Send the subscribe frame. It goes in the control lane, as UNSUBSCRIBE
+  // does, so an UNSUBSCRIBE can never overtake the SUBSCRIBE it cancels.
+  currentSession->send( std::move( subscribeFrame ), STOMP_LANE_CONTROL );
+}
+
 
-  // Send the connection frame
-  currentSession->send( subscribeFrame.c_str() );
+template< class Policies >
+void BasicStompClient<Policies>::subscribe( int id, char const *destination, char const* ack, Handler handler, void* context )
+{
+  // Register the handler first so we cannot miss the first message.
+  {
+    std::unique_lock<Mutex> locker( g_subscriptions );
+    Subscription& subscription = subscriptions[ id ];
+    subscription.handler = std::move( handler );
+    subscription.context = context;
+  }
+
+  subscribe( id, destination, ack );
 }
 
 
-void StompClient::unsubscribe( int id )
+template< class Policies >
+void BasicStompClient<Policies>::unsubscribe( int id )
 {
-  std::cout << "Unsubscribing from id " << id << std::endl;
-  std::string unsubscribeFrame = makeUnsubscribeFrame( id );
+  Logger::info( "Unsubscribing from id ", id );
+  std::string unsubscribeFrame = currentSession->acquireBuffer();
+  makeUnsubscribeFrame( unsubscribeFrame, id );
+
+  // A conflating queue waits for its handler to finish when it goes (unless
+  // this is that handler), so let it go outside the lock.
+  std::shared_ptr<StompConflatingQueue> conflation;
+  {
+    std::unique_lock<Mutex> locker( g_subscriptions );
+    auto found = subscriptions.find( id );
+    if( found != subscriptions.end() )
+    {
+      conflation = std::move( found->second.conflation );
+      subscriptions.erase( found );
+    }
+  }
+
+  // Partial messages on it will never be finished. They belong to the io
+  // thread, so they are dropped there.
+  net::post( *ioc, [this, id]() { dropReassemblies( id ); } );
 
   // Send the unsubscribe frame
-  currentSession->send( unsubscribeFrame.c_str() );
+  currentSession->send( std::move( unsubscribeFrame ), STOMP_LANE_CONTROL );
+}
+
+// Acknowledge a message on a client-acknowledged subscription
+template< class Policies >
+void BasicStompClient<Policies>::ack( const StompFrame& message )
+{
+  std::string ackFrame = currentSession->acquireBuffer();
+  makeAckFrame( ackFrame, "ACK", message );
+  currentSession->send( std::move( ackFrame ), STOMP_LANE_CONTROL );
+}
+
+// Tell the broker we did not handle a message
+template< class Policies >
+void BasicStompClient<Policies>::nack( const StompFrame& message )
+{
+  std::string nackFrame = currentSession->acquireBuffer();
+  makeAckFrame( nackFrame, "NACK", message );
+  currentSession->send( std::move( nackFrame ), STOMP_LANE_CONTROL );
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setDeduplication( int id, std::size_t windowSize )
+{
+  std::unique_lock<Mutex> locker( g_subscriptions );
+  Subscription& subscription = subscriptions[ id ];
+  if( windowSize > 0 )
+  {
+    subscription.dedup = std::make_shared<StompDedupWindow>( windowSize );
+  }
+  else
+  {
+    subscription.dedup.reset();
+  }
+}
+
+template< class Policies >
+bool BasicStompClient<Policies>::setConflation( int id, StompConflateBy by, const char* key, std::size_t threshold )
+{
+  if constexpr( !std::is_same<Handler, frameHandler>::value )
+  {
+    Logger::error( "Conflation needs function pointer handlers: not conflating ", id );
+    return false;
+  }
+  if constexpr( std::is_same<Executor, StompInlineExecutor>::value )
+  {
+    Logger::error( "Conflation needs a threaded executor: not conflating ", id );
+    return false;
+  }
+
+  std::shared_ptr<StompConflatingQueue> conflation;
+  if( threshold > 0 )
+  {
+    conflation = std::make_shared<StompConflatingQueue>( by, key, threshold );
+  }
+
+  // Whatever was there before goes outside the lock, as in unsubscribe().
+  std::unique_lock<Mutex> locker( g_subscriptions );
+  subscriptions[ id ].conflation.swap( conflation );
+  locker.unlock();
+  return true;
+}
+
+template< class Policies >
+bool BasicStompClient<Policies>::setSpillJournal( const char* path, std::size_t capacity )
+{
+  std::unique_lock<Mutex> locker( g_journal );
+  return spillJournal.open( path, capacity );
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setWriteQueueLimit( std::size_t bytes )
+{
+  writeQueueLimit = bytes;
+}
+
+// The connection has dropped, so anything sent from now on is journaled,
+// and whatever was drained from the journal but not written goes again.
+// Partial messages will never be finished now.
+template< class Policies >
+void BasicStompClient<Policies>::onDisconnect()
+{
+  stompConnected = false;
+  reassemblies.clear();
+  failCalls();
+  std::unique_lock<Mutex> locker( g_journal );
+  spillJournal.rewind();
+}
+
+// The write queue has emptied, so everything drained from the journal has
+// been written, and there is room for more of it. The journal is only ever
+// drained on the io thread, as this is called, so nothing can have been
+// drained since the queue emptied.
+template< class Policies >
+void BasicStompClient<Policies>::onWritable()
+{
+  {
+    std::unique_lock<Mutex> locker( g_journal );
+    spillJournal.commit();
+  }
+  drainJournal();
+}
+
+// Divert a SEND frame into the journal if it cannot be written now, or if
+// earlier frames are still waiting there (so the order is kept). Returns
+// true if the journal took the frame, or if it had to be dropped because the
+// journal is full.
+template< class Policies >
+bool BasicStompClient<Policies>::spill( string& frame )
+{
+  std::unique_lock<Mutex> locker( g_journal );
+  if( !spillJournal.isOpen() )
+  {
+    return false;
+  }
+
+  bool backedUp = writeQueueLimit > 0 && currentSession->queuedBytes() > writeQueueLimit;
+  if( stompConnected && !backedUp && spillJournal.empty() )
+  {
+    return false;
+  }
+
+  if( !spillJournal.append( frame.data(), frame.size() ) )
+  {
+    Logger::info( "Spill journal is full: dropping message" );
+  }
+  currentSession->recycleBuffer( frame );
+  return true;
+}
+
+// Move journaled frames onto the write queue, for as long as we are
+// connected and the queue has room. Each frame is sent on its own: over a
+// WebSocket every send() is one message, and brokers take one frame per
+// message. The write queue writes them out back to back anyway.
+template< class Policies >
+void BasicStompClient<Policies>::drainJournal()
+{
+  std::unique_lock<Mutex> locker( g_journal );
+  std::size_t limit = writeQueueLimit > 0 ? writeQueueLimit : JOURNAL_BATCH_SIZE;
+  while( stompConnected && !spillJournal.empty() && currentSession->queuedBytes() < limit )
+  {
+    std::string frame = currentSession->acquireBuffer();
+    spillJournal.drain( frame, 0 );
+    currentSession->send( std::move( frame ) );
+  }
 }
 
 // Send a message to the server
-void StompClient::send( char const* destination, char const *contentType, char const *body )
+template< class Policies >
+void BasicStompClient<Policies>::send( char const* destination, char const *contentType, char const *body )
+{
+  Logger::info( "Sending message ", body );
+  // Very large bodies go in pieces, if we have been asked to do that.
+  std::size_t length = body != NULL ? strlen( body ) : 0;
+  if( fragmentSize > 0 && length > fragmentSize )
+  {
+    sendFragments( destination, contentType, body, length );
+    return;
+  }
+
+  std::string sendFrame = currentSession->acquireBuffer();
+  makeSendFrame( sendFrame, destination, contentType, body );
+  BasicStompClient::sendFrame( sendFrame );
+}
+
+// Something to tell this client's messages apart from other producers' at
+// the consumer.
+static string randomId()
+{
+  std::random_device random;
+  std::uint64_t      id = ( std::uint64_t( random() ) << 32 ) | random();
+  char               text[ 16 ];
+  return string( text, std::to_chars( text, text + sizeof( text ), id, 16 ).ptr );
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setFragmentSize( std::size_t bytes )
+{
+  fragmentSize   = bytes;
+  fragmentPrefix = randomId();
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setLatencyStamping( bool stamp )
+{
+  // The id is set once, before stamping is first turned on, and never
+  // changed, so senders that see stamping on can read it without the lock.
+  std::unique_lock<SharedMutex> locker( g_stamps );
+  if( producerId.empty() )
+  {
+    producerId = randomId();
+  }
+  latencyStamping = stamp;
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setLatencyTracking( bool track, gapHandler handler, void* context )
+{
+  latencyGapHandler = handler;
+  latencyGapContext = context;
+  latencyTracking   = track;
+}
+
+template< class Policies >
+const StompLatencyHistogram& BasicStompClient<Policies>::latencyHistogram() const
+{
+  return deliveryLatency;
+}
+
+template< class Policies >
+const StompSequenceTracker& BasicStompClient<Policies>::sequenceTracker() const
+{
+  return deliverySequences;
+}
+
+// Nanoseconds of the system clock, which is the one hosts keep in step.
+static std::int64_t wallClockNanoseconds()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+// Add this producer's id, its next sequence number to the destination and the
+// time to a SEND frame. Once a destination has been seen, this neither
+// allocates nor takes more than a shared lock.
+template< class Policies >
+void BasicStompClient<Policies>::appendStamp( string& frame, const char* destination )
 {
-  std::cout << "Sending message " << body << std::endl;
-  std::string sendFrame = makeSendFrame( destination, contentType, body );
+  std::uint64_t sequence;
+  {
+    std::shared_lock<SharedMutex> reader( g_stamps );
+    auto found = sendSequences.find( std::string_view( destination ) );
+    if( found != sendSequences.end() )
+    {
+      sequence = found->second++;
+    }
+    else
+    {
+      reader.unlock();
+      std::unique_lock<SharedMutex> writer( g_stamps );
+      sequence = sendSequences.try_emplace( destination, 0 ).first->second++;
+    }
+  }
 
-  // Send the message
-  currentSession->send( sendFrame.c_str() );
+  char number[ 24 ];
+  frame += "stomp-producer:";
+  frame += producerId;
+  frame += EOL;
+  frame += "stomp-sequence:";
+  frame.append( number, std::to_chars( number, number + sizeof( number ), sequence ).ptr );
+  frame += EOL;
+  frame += "stomp-timestamp:";
+  frame.append( number, std::to_chars( number, number + sizeof( number ), wallClockNanoseconds() ).ptr );
+  frame += EOL;
+}
+
+// Read the stamp off a message: how long it took to get here, and whether
+// any from the same producer to the same destination went missing first.
+template< class Policies >
+void BasicStompClient<Policies>::trackLatency( const StompFrame& frame )
+{
+  std::int64_t sentAt = 0;
+  if( headerNumber( frame.header( HEADER_STOMP_TIMESTAMP ), sentAt ) )
+  {
+    deliveryLatency.record( wallClockNanoseconds() - sentAt );
+  }
+
+  std::uint64_t sequence = 0;
+  if( !frame.has( HEADER_STOMP_PRODUCER ) || !headerNumber( frame.header( HEADER_STOMP_SEQUENCE ), sequence ) )
+  {
+    return;
+  }
+  std::string_view producer    = frame.header( HEADER_STOMP_PRODUCER );
+  std::string_view destination = frame.header( HEADER_DESTINATION );
+  std::uint64_t    missing     = deliverySequences.observe( producer, destination, sequence );
+  if( missing > 0 )
+  {
+    Logger::info( "Missing ", missing, " messages from ", producer, " to ", destination );
+    if( latencyGapHandler != NULL )
+    {
+      latencyGapHandler( producer, destination, sequence - missing, missing, latencyGapContext );
+    }
+  }
+}
+
+// Send a body as a run of SEND frames of at most fragmentSize bytes each.
+template< class Policies >
+void BasicStompClient<Policies>::sendFragments( const char* destination, const char* contentType, const char *body, std::size_t length )
+{
+  string fragmentId = fragmentPrefix;
+  fragmentId += '-';
+  fragmentId += std::to_string( nextFragment++ );
+
+  std::size_t count = ( length + fragmentSize - 1 ) / fragmentSize;
+  for( std::size_t index = 0; index < count; index++ )
+  {
+    std::size_t      offset = index * fragmentSize;
+    std::string_view slice( body + offset, std::min( fragmentSize, length - offset ) );
+
+    std::string fragmentFrame = currentSession->acquireBuffer();
+    makeFragmentFrame( fragmentFrame, destination, contentType, slice, index + 1 == count, fragmentId, index, count );
+    sendFrame( fragmentFrame );
+  }
+}
+
+// Send a finished SEND frame, unless it has to wait in the journal.
+template< class Policies >
+void BasicStompClient<Policies>::sendFrame( string& frame )
+{
+  // If it cannot go out just now, it goes into the journal ...
+  if( spill( frame ) )
+  {
+    return;
+  }
+
+  // ... otherwise send the message
+  currentSession->send( std::move( frame ) );
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::setReplyQueue( const char* destination, int id )
+{
+  std::unique_lock<Mutex> locker( g_calls );
+  replyQueue        = destination;
+  replySubscription = id;
+}
+
+// Hand the reply, or the lack of one, to a request made with a future.
+static void fulfilPromise( const StompFrame* reply, void* context )
+{
+  std::unique_ptr< std::promise<StompMessage> > promise( static_cast<std::promise<StompMessage>*>( context ) );
+  promise->set_value( reply != NULL ? reply->retain() : StompMessage() );
+}
+
+template< class Policies >
+std::future<StompMessage> BasicStompClient<Policies>::request( const char* destination, const char* contentType, const char *body,
+						std::chrono::milliseconds timeout )
+{
+  std::promise<StompMessage>* promise = new std::promise<StompMessage>();
+  std::future<StompMessage>   reply   = promise->get_future();
+  request( destination, contentType, body, timeout, fulfilPromise, promise );
+  return executor.waitable( std::move( reply ) );
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::request( const char* destination, const char* contentType, const char *body,
+			   std::chrono::milliseconds timeout, replyHandler handler, void* context )
+{
+  std::uint64_t id;
+  string        replyTo;
+  {
+    std::unique_lock<Mutex> locker( g_calls );
+
+    // All the replies come back on one subscription, made the first time
+    // round. Doing it under the lock keeps every request behind it.
+    if( !replySubscribed )
+    {
+      subscribe( replySubscription, replyQueue.c_str(), "auto", deliverReply, this );
+      replySubscribed = true;
+    }
+
+    id      = pendingCalls.add( timeout, handler, context );
+    replyTo = replyQueue;
+
+    // Start the clock if it is not already going.
+    if( !callTimerRunning )
+    {
+      callTimerRunning = true;
+      net::post( *ioc, [this]() { expireCalls( beast::error_code() ); } );
+    }
+  }
+
+  char correlationId[ 24 ];
+  *std::to_chars( correlationId, correlationId + sizeof( correlationId ) - 1, id ).ptr = '\0';
+
+  std::string requestFrame = currentSession->acquireBuffer();
+  makeSendFrame( requestFrame, destination, contentType, body, replyTo.c_str(), correlationId );
+  sendFrame( requestFrame );
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::reply( const StompFrame& request, const char* contentType, const char *body )
+{
+  if( !request.has( HEADER_REPLY_TO ) )
+  {
+    return;
+  }
+
+  // The header values are not NUL-terminated where they lie in the frame.
+  string replyTo( request.header( HEADER_REPLY_TO ) );
+  string correlationId( request.header( HEADER_CORRELATION_ID ) );
+
+  std::string replyFrame = currentSession->acquireBuffer();
+  makeSendFrame( replyFrame, replyTo.c_str(), contentType, body, NULL,
+		 request.has( HEADER_CORRELATION_ID ) ? correlationId.c_str() : NULL );
+  sendFrame( replyFrame );
+}
+
+// Everything arriving on the reply queue comes through here.
+template< class Policies >
+void BasicStompClient<Policies>::deliverReply( const StompFrame& frame, void* context )
+{
+  static_cast<BasicStompClient*>( context )->completeCall( frame );
+}
+
+// Find the request a reply belongs to and hand the reply over. Replies that
+// come too late, or that are not ours, are dropped.
+template< class Policies >
+void BasicStompClient<Policies>::completeCall( const StompFrame& reply )
+{
+  std::string_view correlationId = reply.header( HEADER_CORRELATION_ID );
+  std::uint64_t    id = 0;
+  auto parsed = std::from_chars( correlationId.data(), correlationId.data() + correlationId.size(), id );
+  if( correlationId.empty() || parsed.ec != std::errc() )
+  {
+    return;
+  }
+
+  StompPendingCalls::Call call;
+  {
+    std::unique_lock<Mutex> locker( g_calls );
+    if( !pendingCalls.take( id, call ) )
+    {
+      return;
+    }
+  }
+  call.handler( &reply, call.context );
+}
+
+// Time out the requests whose time is up, then wait for the next tick. The
+// clock stops once nothing is outstanding.
+template< class Policies >
+void BasicStompClient<Policies>::expireCalls( beast::error_code ec )
+{
+  if( ec )
+  {
+    return;
+  }
+
+  std::vector<StompPendingCalls::Call> expired;
+  {
+    std::unique_lock<Mutex> locker( g_calls );
+    pendingCalls.expire( std::chrono::steady_clock::now(), expired );
+    if( pendingCalls.empty() )
+    {
+      callTimerRunning = false;
+    }
+    else
+    {
+      callTimer->expires_after( pendingCalls.tick() );
+      callTimer->async_wait( [this]( beast::error_code ec ) { expireCalls( ec ); } );
+    }
+  }
+
+  for( StompPendingCalls::Call& call : expired )
+  {
+    call.handler( NULL, call.context );
+  }
+}
+
+// The replies will not come now, so give every call still waiting what a
+// timeout would, without waiting for the timeout.
+template< class Policies >
+void BasicStompClient<Policies>::failCalls()
+{
+  std::vector<StompPendingCalls::Call> failed;
+  {
+    std::unique_lock<Mutex> locker( g_calls );
+    pendingCalls.takeAll( failed );
+  }
+
+  for( StompPendingCalls::Call& call : failed )
+  {
+    call.handler( NULL, call.context );
+  }
 }
 
 // Disconnect from the WebSocket
-void StompClient::disconnect( int receipt )
+template< class Policies >
+void BasicStompClient<Policies>::disconnect( int receipt )
 {
-  string disconnectFrame = makeDisconnectFrame( receipt );
-  currentSession->send( disconnectFrame.c_str() );
+  string disconnectFrame = currentSession->acquireBuffer();
+  makeDisconnectFrame( disconnectFrame, receipt );
+  currentSession->send( std::move( disconnectFrame ) );
 }
 
-// Close the WebSocket
-void StompClient::close()
+// Close the connection
+template< class Policies >
+void BasicStompClient<Policies>::close()
 {
-  std::cout << "Closing WebSocket" << std::endl;
+  Logger::info( "Closing connection" );
   currentSession->close();
 }
 
 // This is used by the client to "wait" for all the operations to finish
-void StompClient::synchronize()
+template< class Policies >
+void BasicStompClient<Policies>::synchronize()
 {
   //std::cout << "Waiting on ioc thread" << std::endl;
-  iocRunnerThread->join();
+  executor.join();
+}
+
+template< class Policies >
+std::size_t BasicStompClient<Policies>::poll()
+{
+  return executor.poll();
 }
 
 
 // Wait for a message to be received
-void StompClient::synchronizeMessage()
+template< class Policies >
+void BasicStompClient<Policies>::synchronizeMessage()
 {
-  std::unique_lock<std::mutex> locker( g_message );
-  g_messagecheck.wait( locker );
+  std::unique_lock<Mutex> locker( g_message );
+  executor.wait( locker, g_messagecheck );
 }
 
 // Wait for a receipt to be received
-void StompClient::synchronizeReceipt()
+template< class Policies >
+void BasicStompClient<Policies>::synchronizeReceipt()
 {
-  std::unique_lock<std::mutex> locker( g_receipt );
-  g_receiptcheck.wait( locker );
+  std::unique_lock<Mutex> locker( g_receipt );
+  executor.wait( locker, g_receiptcheck );
 }
   
 // Helper functions
-string StompClient::makeConnectFrame( const char* version, const char* host, const char *login, const char *passcode )
+template< class Policies >
+void BasicStompClient<Policies>::makeConnectFrame( string& frame, const char* version, const char* host, const char *login, const char *passcode )
 {
-  string frame = "CONNECT";
+  frame += "CONNECT";
   frame += EOL;
   frame += "accept-version:";
   frame += version;
@@ -235,45 +1323,44 @@ string StompClient::makeConnectFrame( const char* version, const char* host, con
   }
   frame += EOL;
   frame += EOL;
-
-  return frame;  
+  frame.append( TERMINATOR, 2 );
 }
 
-string StompClient::makeSubscribeFrame( int id, const char *destination, const char* ack )
+template< class Policies >
+void BasicStompClient<Policies>::makeSubscribeFrame( string& frame, int id, const char *destination, const char* ack )
 {
-  string frame = "SUBSCRIBE";
+  frame += "SUBSCRIBE";
   frame += EOL;
   frame += "id:";
   frame += std::to_string( id );
   frame += EOL;
-  frame += "destination:";
-  frame += destination;
-  frame += EOL;
-  if( ack != NULL )
-  {
-    frame += "ack:";
-    frame += ack;
-  }
-  else
-  {
-    frame += "ack:auto";
-  }
-  frame += EOL;
+  appendHeader( frame, "destination", destination, version );
+  appendHeader( frame, "ack", ack != NULL ? ack : "auto", version );
   frame += EOL;
-  return frame;
+  frame.append( TERMINATOR, 2 );
 }
 
 
-string StompClient::makeSendFrame( const char* destination, const char* contentType, const char *body )
+template< class Policies >
+void BasicStompClient<Policies>::makeSendFrame( string& frame, const char* destination, const char* contentType, const char *body,
+				 const char* replyTo, const char* correlationId )
 {
-  string frame = "SEND";
-  frame += EOL;
-  frame += "destination:";
-  frame += destination;
-  frame += EOL;
-  frame += "content-type:";
-  frame += contentType;
+  frame += "SEND";
   frame += EOL;
+  appendHeader( frame, "destination", destination, version );
+  appendHeader( frame, "content-type", contentType, version );
+  if( latencyStamping )
+  {
+    appendStamp( frame, destination );
+  }
+  if( replyTo != NULL )
+  {
+    appendHeader( frame, "reply-to", replyTo, version );
+  }
+  if( correlationId != NULL )
+  {
+    appendHeader( frame, "correlation-id", correlationId, version );
+  }
   int frameLength = 0;
   if( body != NULL )
   {
@@ -292,30 +1379,92 @@ string StompClient::makeSendFrame( const char* destination, const char* contentT
   }
 
   frame += EOL;
-  return frame;
+  frame.append( TERMINATOR, 2 );
 }
 
 
-string StompClient::makeUnsubscribeFrame( int id )
+// One piece of a fragmented SEND. The last piece ends with the EOL that
+// makeSendFrame puts after a body, so the reassembled body is the same.
+template< class Policies >
+void BasicStompClient<Policies>::makeFragmentFrame( string& frame, const char* destination, const char* contentType, std::string_view slice,
+				     bool last, std::string_view fragmentId, std::size_t index, std::size_t count )
 {
-  string frame = "UNSUBSCRIBE";
+  frame += "SEND";
+  frame += EOL;
+  appendHeader( frame, "destination", destination, version );
+  appendHeader( frame, "content-type", contentType, version );
+  appendHeader( frame, "fragment-id", fragmentId, version );
+
+  // A fragmented message is stamped once, on its last fragment, whose
+  // headers the reassembled message keeps.
+  if( last && latencyStamping )
+  {
+    appendStamp( frame, destination );
+  }
+  frame += "fragment-index:";
+  frame += std::to_string( index );
+  frame += EOL;
+  frame += "fragment-count:";
+  frame += std::to_string( count );
+  frame += EOL;
+  frame += "content-length:";
+  frame += std::to_string( slice.size() + ( last ? strlen( EOL ) : 0 ) );
+  frame += EOL;
+  frame += EOL;
+  frame.append( slice.data(), slice.size() );
+  if( last )
+  {
+    frame += EOL;
+  }
+  frame.append( TERMINATOR, 2 );
+}
+
+template< class Policies >
+void BasicStompClient<Policies>::makeUnsubscribeFrame( string& frame, int id )
+{
+  frame += "UNSUBSCRIBE";
   frame += EOL;
   frame += "id:";
   frame += std::to_string( id );
   frame += EOL;
   frame += EOL;
-  return frame;
+  frame.append( TERMINATOR, 2 );
 }
   
 
-string StompClient::makeDisconnectFrame( int receipt )
+template< class Policies >
+void BasicStompClient<Policies>::makeDisconnectFrame( string& frame, int receipt )
 {
-  string frame = "DISCONNECT";
+  frame += "DISCONNECT";
   frame += EOL;
   frame += "receipt:";
   frame += std::to_string( receipt );
   frame += EOL;
   frame += EOL;
-  return frame;
+  frame.append( TERMINATOR, 2 );
+}
+
+
+// 1.2 acknowledges by the message's ack header; 1.1 by its message-id and
+// subscription.
+template< class Policies >
+void BasicStompClient<Policies>::makeAckFrame( string& frame, const char* command, const StompFrame& message )
+{
+  frame += command;
+  frame += EOL;
+  if( version == STOMP_1_2 )
+  {
+    appendHeader( frame, "id", message.header( HEADER_ACK ), version );
+  }
+  else
+  {
+    appendHeader( frame, "message-id", message.header( HEADER_MESSAGE_ID ), version );
+    appendHeader( frame, "subscription", message.header( HEADER_SUBSCRIPTION ), version );
+  }
+  frame += EOL;
+  frame.append( TERMINATOR, 2 );
 }
 
+// The policy sets in use. Any other set needs a line of its own here.
+template class BasicStompClient<StompDefaultPolicies>;
+template class BasicStompClient<StompLeanPolicies>;
@@ -2,52 +2,385 @@
 
 // Standard includes
 #include <string>
+#include <atomic>
+#include <unordered_map>
+#include <map>
+#include <shared_mutex>
+#include <memory_resource>
+#include <vector>
+#include <chrono>
+#include <future>
 using std::string;
 
-// Websocket include
+// Transports
 #include "WebSocketSession.h"
+#include "TcpSession.h"
 #include "WebSocketCallbacks.h"
 
-class StompClient : public websocketcallbacks
+// Frame parsing and encoding
+#include "StompFrame.h"
+
+// Redelivery detection
+#include "StompDedup.h"
+
+// Store-and-forward for sends while disconnected
+#include "StompJournal.h"
+
+// Conflating queues for slow subscribers
+#include "StompConflate.h"
+
+// Latency and gap measurement
+#include "StompLatency.h"
+
+// Streaming very large frames
+#include "StompStream.h"
+
+// Request/reply calls waiting for their replies
+#include "StompRpc.h"
+
+// The logger, executor, allocation and handler policies
+#include "StompPolicies.h"
+
+// Where to find a broker. As for connect(), the path is the WebSocket path,
+// or the socket's path for STOMP_OVER_UNIX.
+struct StompEndpoint
+{
+  string host;
+  string port;
+  string path;
+};
+
+// Handlers for gaps in a producer's sequence numbers: missing messages, the
+// first of them numbered expected, did not arrive at the destination.
+typedef void (*gapHandler)( std::string_view producer, std::string_view destination, std::uint64_t expected,
+			    std::uint64_t missing, void* context );
+
+// The client, built from a set of policies (see StompPolicies.h): its
+// logger, its executor, where received frames are allocated and what a frame
+// handler is. StompClient is the default set; StompLeanClient runs everything
+// on the caller's thread, without the client's locks or any logging.
+template< class Policies >
+class BasicStompClient final : public websocketcallbacks
 {
  public:
-  void connect( const char* host, const char *port, const char* path, const char *login, const char *passcode );
+  // Drops the connection, if there is one, and stops the io thread. This
+  // waits for the io thread to finish, so the client cannot be destroyed, or
+  // connected again, from a handler running on it.
+  ~BasicStompClient();
+
+  typedef typename Policies::logger                  Logger;
+  typedef typename Policies::executor                Executor;
+  typedef typename Policies::allocation              Allocation;
+  typedef typename Policies::handlers                Handlers;
+  typedef typename Policies::executor::mutex         Mutex;
+  typedef typename Policies::executor::shared_mutex  SharedMutex;
+  typedef typename Policies::executor::condition     Condition;
+  typedef typename Policies::handlers::handler       Handler;
+
+  // Connect to a broker and wait until it has answered with CONNECTED.
+  // Returns false if that does not happen within the timeout, or if every
+  // broker has failed. Given several endpoints, an attempt is started on the
+  // first, then on each of the next in turn every stagger (or as soon as an
+  // earlier one fails), and they race: the first to be CONNECTED is kept and
+  // the others are dropped.
+  bool connect( const char* host, const char *port, const char* path, const char *login, const char *passcode );
+  bool connect( const std::vector<StompEndpoint>& endpoints, const char *login, const char *passcode,
+		std::chrono::milliseconds timeout = std::chrono::seconds( 30 ),
+		std::chrono::milliseconds stagger = std::chrono::milliseconds( 250 ) );
   void subscribe( int id, const char *destination, const char* ack );
+  void subscribe( int id, const char *destination, const char* ack, Handler handler, void* context = NULL );
   void send( const char* destination, const char* contentType, const char *body );
+
+  // Send a request carrying a new correlation-id, with reply-to set to the
+  // reply queue, and match the reply to it when it comes back. The future is
+  // given the reply, or an empty message (with no command) if none came within
+  // the timeout. Alternatively, the handler is called on the io thread with
+  // the reply, or with NULL on a timeout. Calls still waiting when the
+  // connection drops, or when the client connects again or is destroyed, are
+  // given the same as on a timeout there and then; the handler may then be
+  // called on the thread doing that. With the inline executor, waiting on
+  // the future runs the io_context until the reply is in.
+  std::future<StompMessage> request( const char* destination, const char* contentType, const char *body,
+				     std::chrono::milliseconds timeout );
+  void request( const char* destination, const char* contentType, const char *body,
+		std::chrono::milliseconds timeout, replyHandler handler, void* context = NULL );
+
+  // Send SEND bodies longer than this many bytes as a run of smaller SEND
+  // frames, so that frames queued behind a very large message are not held
+  // up until all of it has been written. Each fragment carries fragment-id,
+  // fragment-index and fragment-count headers, and a receiving StompClient
+  // puts the message back together before handing it on, so only use this
+  // when the consumers are StompClients too. 0, the default, turns it off.
+  void setFragmentSize( std::size_t bytes );
+
+  // Stamp every SEND with a stomp-producer id for this client, a
+  // stomp-sequence number counting up from 0 for each destination, and a
+  // stomp-timestamp of the system clock in nanoseconds. A fragmented SEND
+  // is stamped once, on its last fragment. The numbers only follow the order
+  // the frames go out in if each destination is sent to from one thread.
+  void setLatencyStamping( bool stamp );
+
+  // Time stamped messages as they arrive, from their stomp-timestamp to
+  // dispatch, into the latency histogram, and follow each producer's sequence
+  // numbers to each destination, calling handler (if there is one) where
+  // there are gaps. Across hosts, the latencies are only as good as the
+  // clocks' agreement.
+  void setLatencyTracking( bool track, gapHandler handler = NULL, void* context = NULL );
+  const StompLatencyHistogram& latencyHistogram() const;
+  const StompSequenceTracker&  sequenceTracker() const;
+
+  // Answer a request: send the body to its reply-to destination, carrying its
+  // correlation-id. Does nothing if the request has no reply-to.
+  void reply( const StompFrame& request, const char* contentType, const char *body );
+
+  // Where replies to requests are sent, and the id of the one subscription
+  // they all arrive on. The queue is subscribed to with the first request.
+  // This has to be called before then.
+  void setReplyQueue( const char* destination, int id );
   void unsubscribe( int id );
+  void ack( const StompFrame& message );
+  void nack( const StompFrame& message );
   void disconnect( int receipt );
   void close();
   void synchronizeMessage();
   void synchronizeReceipt();
   void synchronize();
 
+  // Run whatever work is ready on the calling thread, without waiting, and
+  // return how much there was. This is how the inline executor is driven
+  // between calls; with the threaded executor it does nothing.
+  std::size_t poll();
+
+  // Choose how to reach the broker. This has to be called before connect().
+  // For STOMP_OVER_UNIX, the path given to connect() is the socket's path.
+  void setTransport( StompTransportType type );
+
+  // Tune the socket once it is connected. The buffer sizes and busy-poll
+  // apply to every transport; the rest only to TCP. Call before connect().
+  void setSocketOptions( const StompSocketOptions& options );
+
+  // Choose how the io thread runs, and pin it to a core if cpu is not -1.
+  // Busy-polling is best paired with a pinned, otherwise idle core and with
+  // the busyPoll socket option. Call before connect().
+  void setRunMode( StompRunMode mode, int cpu = -1 );
+
   // Set the message handlers
   void setMessageHandler( void (*handler)(string body) );
-  
+  void setFrameHandler( Handler handler, void* context = NULL );
+
+  // Stream frames with bodies of more than threshold bytes instead of holding
+  // them in memory: once the headers are in, the handler is given the body a
+  // chunk at a time, on the io thread. These frames bypass the subscription
+  // and default handlers. Smaller frames are dispatched as usual. This has to
+  // be called before connect().
+  void setStreamHandler( chunkHandler handler, void* context, std::size_t threshold );
+
+  // The biggest message to hold in memory whole; a bigger one drops the
+  // connection. 0 keeps the transport's own limit (16 MB for a WebSocket,
+  // none otherwise). When streaming, this only applies up to CONNECTED. This
+  // has to be called before connect().
+  void setReadMessageMax( std::size_t bytes );
+
+  // Set the size of the per-connection arena that received frames are parsed
+  // into, if the allocation policy has one. Frames that need more than this
+  // fall back to the heap. This has to be called before connect().
+  void setFrameArenaSize( std::size_t size );
+
+  // Drop messages on a subscription whose message-id was among the last
+  // windowSize seen on it, as happens when the broker redelivers after a
+  // reconnect or a NACK. Repeats on a "client-individual" subscription are
+  // acknowledged without being dispatched. Under "client" an ACK also covers
+  // every message before it, including ones not yet handled, so repeats
+  // there are dropped without one. A window size of 0 turns this off.
+  void setDeduplication( int id, std::size_t windowSize );
+
+  // Hand a subscription's messages to its handler on a thread of their own,
+  // through a queue that, once threshold or more messages are waiting, keeps
+  // only the latest message for each key. The key is the named header,
+  // or the named field of a JSON body. Only for "auto" acknowledgement; see
+  // StompConflatingQueue. A threshold of 0 turns this off. Returns false,
+  // and changes nothing, if the policies do not allow it: the handlers have
+  // to be function pointers, and the client's state has to be locked, since
+  // the handler runs on another thread (so not with the inline executor).
+  bool setConflation( int id, StompConflateBy by, const char* key, std::size_t threshold );
+
+  // Keep SEND frames in a memory-mapped journal file, rather than losing
+  // them, while the connection is down or more than the write queue limit is
+  // waiting to be written. They are sent, in order, once the connection is
+  // back; the write queue writes them out back to back. They stay in the journal until they have been
+  // written, so if the connection drops again first they are sent again.
+  // Returns false if the journal cannot be opened.
+  bool setSpillJournal( const char* path, std::size_t capacity );
+  void setWriteQueueLimit( std::size_t bytes );
+
   // Callbacks
-  void onRead( char const* message );
+  void onRead( char* message, std::size_t length );
+  void onReadSome( char* data, std::size_t length );
+  void onDisconnect();
+  void onWritable();
 
   // These are used to force synchronous receipt of messages and receipts
-  std::condition_variable g_messagecheck;
-  std::mutex              g_message;
-  std::condition_variable g_receiptcheck;
-  std::mutex              g_receipt;
+  Condition g_messagecheck;
+  Mutex     g_message;
+  Condition g_receiptcheck;
+  Mutex     g_receipt;
 
  private:
+  // One of the attempts racing to connect. It stands between its transport
+  // and the client, so the client can tell which attempt an event came from.
+  struct ConnectAttempt : public websocketcallbacks
+  {
+    BasicStompClient          *client;
+    StompEndpoint              endpoint;
+    std::shared_ptr<transport> session;
+    string                     connectFrame;
+    bool                       failed = false;
+
+    void onConnected()                                 { client->attemptConnected( this ); }
+    void onRead( char* message, std::size_t length )   { client->attemptRead( this, message, length ); }
+    void onReadSome( char* data, std::size_t length )  { client->onReadSome( data, length ); }
+    void onDisconnect()                                { client->attemptFailed( this ); }
+    void onWritable()                                  { client->attemptWritable( this ); }
+  };
+
   // Helper functions
-  string makeConnectFrame( const char* version, const char* host, const char *login, const char *passcode );
-  string makeSubscribeFrame( int id, const char *destination, const char* ack );
-  string makeSendFrame( const char* destination, const char* contentType, const char *body );
-  string makeUnsubscribeFrame( int id );
-  string makeDisconnectFrame( int receipt );
+  // These append the whole frame, terminator included, to the given buffer.
+  void   makeConnectFrame( string& frame, const char* version, const char* host, const char *login, const char *passcode );
+  void   makeSubscribeFrame( string& frame, int id, const char *destination, const char* ack );
+  void   makeSendFrame( string& frame, const char* destination, const char* contentType, const char *body,
+			const char* replyTo = NULL, const char* correlationId = NULL );
+  void   makeUnsubscribeFrame( string& frame, int id );
+  void   makeDisconnectFrame( string& frame, int receipt );
+  void   makeAckFrame( string& frame, const char* command, const StompFrame& message );
+  void   dispatchFrame( const StompFrame& frame );
+  bool   dispatchToSubscription( const StompFrame& frame );
+  bool   isRedelivery( const StompFrame& frame );
+  bool   spill( string& frame );
+  void   drainJournal();
+  void   makeFragmentFrame( string& frame, const char* destination, const char* contentType, std::string_view slice,
+			    bool last, std::string_view fragmentId, std::size_t index, std::size_t count );
+  void   sendFrame( string& frame );
+  void   sendFragments( const char* destination, const char* contentType, const char *body, std::size_t length );
+  void   reassemble( const StompFrame& fragment );
+  void   makeRoomForReassembly( std::chrono::steady_clock::time_point now );
+  void   dropReassemblies( int id );
+  void   appendStamp( string& frame, const char* destination );
+  void   trackLatency( const StompFrame& frame );
+  void   deliverMessage( const StompFrame& frame );
+  void   shutdownConnection();
+  void   startNextAttempt();
+  void   attemptConnected( ConnectAttempt* attempt );
+  void   attemptRead( ConnectAttempt* attempt, char* message, std::size_t length );
+  void   attemptFailed( ConnectAttempt* attempt );
+  void   attemptWritable( ConnectAttempt* attempt );
+  void   completeCall( const StompFrame& reply );
+  void   expireCalls( beast::error_code ec );
+  void   failCalls();
+  static void deliverReply( const StompFrame& frame, void* context );
 
   // Fields
   static const char* EOL;
-  std::shared_ptr<session> currentSession;
-  std::thread     *iocRunnerThread;
-  net::io_context *ioc;
+  static const char  TERMINATOR[ 2 ];
+  std::atomic<StompVersion> version;
+  std::atomic<bool>         stompConnected;
+  StompTransportType         transportType = STOMP_OVER_WEBSOCKET;
+  StompSocketOptions         socketOptions;
+  StompRunMode               runMode = STOMP_RUN_BLOCKING;
+  int                        runCpu  = -1;
+  std::shared_ptr<transport> currentSession;
+  Executor         executor;
+  net::io_context *ioc = NULL;
+  // The race to connect, guarded by g_connected. Once there is a winner,
+  // currentSession is its transport.
+  std::vector<std::unique_ptr<ConnectAttempt>> attempts;
+  std::size_t                                  attemptsStarted = 0;
+  std::size_t                                  attemptsFailed  = 0;
+  ConnectAttempt                              *winner          = NULL;
+  bool                                         connecting      = false;
+  std::unique_ptr<net::steady_timer>           staggerTimer;
+  std::chrono::milliseconds                    connectStagger;
+  Mutex                                        g_connected;
+  Condition                                    g_connectedcheck;
+
   void (*messageHandler)( string str );
-};
+  Handler                  defaultFrameHandler;
+  void                    *defaultFrameContext;
+
+  // What we know about each subscription, keyed by subscription id.
+  // individualAck is set for "client-individual" acknowledgement, where an
+  // ACK covers just the one message.
+  struct Subscription
+  {
+    Handler                               handler       = Handler();
+    void                                 *context       = NULL;
+    bool                                  individualAck = false;
+    std::shared_ptr<StompDedupWindow>     dedup;
+    std::shared_ptr<StompConflatingQueue> conflation;
+  };
+  std::unordered_map<int, Subscription> subscriptions;
+  Mutex                                 g_subscriptions;
+
+  // Frames waiting for the connection to come back, or for the write queue
+  // to go down. writeQueueLimit is in bytes, 0 meaning no limit; without
+  // one, the journal is drained JOURNAL_BATCH_SIZE bytes at a time.
+  StompSpillJournal spillJournal;
+  Mutex             g_journal;
+  std::size_t       writeQueueLimit = 0;
+  static const std::size_t JOURNAL_BATCH_SIZE = 64 * 1024;
 
+  // Requests waiting for their replies, guarded by g_calls. The timer ticks
+  // on the io thread for as long as any are outstanding.
+  StompPendingCalls                  pendingCalls;
+  Mutex                              g_calls;
+  std::unique_ptr<net::steady_timer> callTimer;
+  bool                               callTimerRunning  = false;
+  string                             replyQueue        = "/temp-queue/replies";
+  int                                replySubscription = -1;
+  bool                               replySubscribed   = false;
+
+  // Fragmenting large SENDs, and putting fragmented MESSAGEs back together.
+  // The reassemblies are keyed by subscription and fragment-id, and are only
+  // touched on the io thread. What the network can make us hold is bounded:
+  // there are at most MAX_REASSEMBLIES at once, one that has not finished
+  // within REASSEMBLY_TIMEOUT is dropped, and so is one that grows past the
+  // message limit.
+  struct Reassembly
+  {
+    string                                body;
+    std::size_t                           next = 0;
+    std::chrono::steady_clock::time_point started;
+  };
+  std::size_t                            fragmentSize = 0;
+  string                                 fragmentPrefix;
+  std::atomic<std::uint64_t>             nextFragment{ 0 };
+  std::unordered_map<string, Reassembly> reassemblies;
+  static const std::size_t               MAX_REASSEMBLIES = 64;
+  static constexpr std::chrono::seconds  REASSEMBLY_TIMEOUT{ 30 };
+
+  // Latency stamps on the way out, and what they tell us on the way in,
+  // which is only touched on the io thread. Senders look their destination's
+  // counter up under a shared lock on g_stamps; adding one takes it whole.
+  std::atomic<bool>                         latencyStamping{ false };
+  string                                    producerId;
+  std::map<string, std::atomic<std::uint64_t>, std::less<>> sendSequences;
+  SharedMutex                               g_stamps;
+  std::atomic<bool>                         latencyTracking{ false };
+  gapHandler                                latencyGapHandler = NULL;
+  void                                     *latencyGapContext = NULL;
+  StompLatencyHistogram                     deliveryLatency;
+  StompSequenceTracker                      deliverySequences;
+
+  // Streaming, which starts once we are CONNECTED
+  chunkHandler                       streamHandler   = NULL;
+  void                              *streamContext   = NULL;
+  std::size_t                        streamThreshold = 0;
+  std::size_t                        readMessageMax  = 0;
+  std::unique_ptr<StompStreamReader> streamReader;
+
+  // Where received frames are parsed into. It is released after every frame.
+  std::size_t frameArenaSize = 64 * 1024;
+  Allocation  frameMemory;
+};
 
-	       
+typedef BasicStompClient<StompDefaultPolicies> StompClient;
+typedef BasicStompClient<StompLeanPolicies>    StompLeanClient;
@@ -0,0 +1,89 @@
+#include "StompConflate.h"
+
+StompConflatingQueue::StompConflatingQueue( StompConflateBy by, const char* key, std::size_t threshold )
+  : by_( by ), key_( key ), threshold_( threshold ), state_( std::make_shared<State>() )
+{
+  worker_ = std::thread( &StompConflatingQueue::run, state_ );
+}
+
+// Wait for the handler to finish, unless this is the handler, dropping its
+// own subscription: a thread cannot join itself, so the worker is left to
+// return from it, and stops there.
+StompConflatingQueue::~StompConflatingQueue()
+{
+  {
+    std::unique_lock<std::mutex> locker( state_->g_queue );
+    state_->stopping_ = true;
+    state_->g_queuecheck.notify_one();
+  }
+  if( worker_.get_id() == std::this_thread::get_id() )
+  {
+    worker_.detach();
+  }
+  else
+  {
+    worker_.join();
+  }
+}
+
+void StompConflatingQueue::push( const StompFrame& frame, frameHandler handler, void* context )
+{
+  std::string_view key = by_ == CONFLATE_BY_HEADER ? frame.header( key_ ) : frame.json().raw( key_ );
+
+  State& state = *state_;
+  std::unique_lock<std::mutex> locker( state.g_queue );
+
+  // From the threshold on, a newer value takes the place of the queued one.
+  if( state.queue_.size() >= threshold_ && !key.empty() )
+  {
+    auto found = state.positions_.find( std::string( key ) );
+    if( found != state.positions_.end() )
+    {
+      Entry& entry  = state.queue_[ found->second - state.head_ ];
+      entry.message = frame.retain();
+      entry.handler = handler;
+      entry.context = context;
+      return;
+    }
+  }
+
+  state.queue_.push_back( Entry{ std::string( key ), frame.retain(), handler, context } );
+  if( !key.empty() )
+  {
+    state.positions_[ state.queue_.back().key ] = state.head_ + state.queue_.size() - 1;
+  }
+  state.g_queuecheck.notify_one();
+}
+
+// The worker: hand the messages over one at a time, oldest first. It only
+// touches the state, which it shares, so the queue may go while it is in a
+// handler.
+void StompConflatingQueue::run( std::shared_ptr<State> shared )
+{
+  State& state = *shared;
+  std::unique_lock<std::mutex> locker( state.g_queue );
+  for( ;; )
+  {
+    state.g_queuecheck.wait( locker, [&state]() { return state.stopping_ || !state.queue_.empty(); } );
+    if( state.stopping_ )
+    {
+      return;
+    }
+
+    Entry entry = std::move( state.queue_.front() );
+    state.queue_.pop_front();
+    if( !entry.key.empty() )
+    {
+      auto found = state.positions_.find( entry.key );
+      if( found != state.positions_.end() && found->second == state.head_ )
+      {
+	state.positions_.erase( found );
+      }
+    }
+    ++state.head_;
+
+    locker.unlock();
+    entry.handler( entry.message.frame(), entry.context );
+    locker.lock();
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// Standard includes
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Frames
+#include "StompFrame.h"
+
+// Where a conflation key comes from.
+enum StompConflateBy
+{
+  CONFLATE_BY_HEADER,   // the value of a header
+  CONFLATE_BY_JSON      // the value of a top-level field of a JSON body
+};
+
+// A queue in front of a slow subscription handler, for last-value-wins
+// feeds. Messages are queued from the io thread and handed to the handler on
+// a thread of the queue's own. While fewer than threshold messages are
+// waiting every message is kept; once threshold or more are, a message
+// replaces the queued one with the same key, in its place in the queue, so the
+// handler only ever sees the latest value for each key. Messages without a key are always kept.
+//
+// The memory used is bounded by the threshold plus the number of distinct
+// keys. Replaced messages are never seen by the handler, so they are never
+// acknowledged either: use this with "auto" acknowledgement.
+class StompConflatingQueue
+{
+ public:
+  StompConflatingQueue( StompConflateBy by, const char* key, std::size_t threshold );
+  ~StompConflatingQueue();
+
+  // Queue a copy of the frame, to be handed to handler.
+  void push( const StompFrame& frame, frameHandler handler, void* context );
+
+ private:
+  struct Entry
+  {
+    std::string  key;
+    StompMessage message;
+    frameHandler handler;
+    void        *context;
+  };
+
+  // Everything the worker touches. The worker holds on to it, so if the
+  // queue goes from inside a handler, the worker can be left to finish that
+  // handler without the queue being there.
+  struct State
+  {
+    // The queue, and for each key the position of its entry in it, counted
+    // from the first message ever queued. All guarded by g_queue.
+    std::mutex                                     g_queue;
+    std::condition_variable                        g_queuecheck;
+    std::deque<Entry>                              queue_;
+    std::uint64_t                                  head_     = 0;
+    std::unordered_map<std::string, std::uint64_t> positions_;
+    bool                                           stopping_ = false;
+  };
+
+  static void run( std::shared_ptr<State> shared );
+
+  StompConflateBy                                by_;
+  std::string                                    key_;
+  std::size_t                                    threshold_;
+  std::shared_ptr<State>                         state_;
+  std::thread                                    worker_;
+};
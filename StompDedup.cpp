@@ -0,0 +1,99 @@
+#include "StompDedup.h"
+
+// FNV-1a, followed by a finalizer so the low bits are well mixed for the
+// table. Zero is kept back to mark empty slots.
+static std::uint64_t hashMessageId( std::string_view messageId )
+{
+  std::uint64_t h = 14695981039346656037ull;
+  for( char c : messageId )
+  {
+    h = ( h ^ static_cast<unsigned char>( c ) ) * 1099511628211ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return h != 0 ? h : 1;
+}
+
+StompDedupWindow::StompDedupWindow( std::size_t windowSize )
+  : ring_( windowSize > 0 ? windowSize : 1, 0 ), next_( 0 ), count_( 0 )
+{
+  // Keep the table at most half full so probes stay short.
+  std::size_t tableSize = 2;
+  while( tableSize < 2 * ring_.size() )
+  {
+    tableSize *= 2;
+  }
+  table_.assign( tableSize, 0 );
+  mask_ = tableSize - 1;
+}
+
+// Find the slot holding hash, or the empty slot where it would go.
+std::size_t StompDedupWindow::findSlot( std::uint64_t hash ) const
+{
+  std::size_t slot = hash & mask_;
+  while( table_[ slot ] != 0 && table_[ slot ] != hash )
+  {
+    slot = ( slot + 1 ) & mask_;
+  }
+  return slot;
+}
+
+// Take a hash out of the table, shifting later entries of the same probe
+// run back so that no lookup is cut short by the hole.
+void StompDedupWindow::erase( std::uint64_t hash )
+{
+  std::size_t hole = findSlot( hash );
+  if( table_[ hole ] != hash )
+  {
+    return;
+  }
+
+  std::size_t next = hole;
+  for( ;; )
+  {
+    next = ( next + 1 ) & mask_;
+    if( table_[ next ] == 0 )
+    {
+      break;
+    }
+
+    // An entry can move back into the hole unless its home slot lies
+    // (cyclically) after the hole and at or before where it is now.
+    std::size_t home = table_[ next ] & mask_;
+    bool staysPut = hole <= next ? ( hole < home && home <= next ) : ( hole < home || home <= next );
+    if( !staysPut )
+    {
+      table_[ hole ] = table_[ next ];
+      hole = next;
+    }
+  }
+  table_[ hole ] = 0;
+}
+
+bool StompDedupWindow::checkAndInsert( std::string_view messageId )
+{
+  std::uint64_t hash = hashMessageId( messageId );
+  std::size_t   slot = findSlot( hash );
+  if( table_[ slot ] == hash )
+  {
+    return true;
+  }
+
+  // Forget the oldest id if the window is full. The slot we found may have
+  // moved as a result, so look again.
+  if( count_ == ring_.size() )
+  {
+    erase( ring_[ next_ ] );
+    slot = findSlot( hash );
+  }
+  else
+  {
+    ++count_;
+  }
+
+  table_[ slot ]  = hash;
+  ring_[ next_ ]  = hash;
+  next_           = ( next_ + 1 ) % ring_.size();
+  return false;
+}
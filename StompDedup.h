@@ -0,0 +1,37 @@
+#pragma once
+
+// Standard includes
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Remembers the last few message-ids seen on a subscription so that
+// redeliveries can be spotted and dropped.
+//
+// Only a 64-bit hash of each id is kept: a ring holds them in arrival order so
+// the oldest can be forgotten once the window is full, and an open-addressed
+// table (at most half full) answers "have we seen this one?" in a probe or
+// two. The memory used is fixed when the window is created, at about 24 bytes
+// per remembered id. Two different ids with the same hash would make the
+// second look like a repeat; with 64-bit hashes and windows of thousands of
+// ids that is not something we expect to see.
+class StompDedupWindow
+{
+ public:
+  explicit StompDedupWindow( std::size_t windowSize );
+
+  // Returns true if the id is already in the window. Otherwise the id is
+  // added, pushing out the oldest one if the window is full.
+  bool checkAndInsert( std::string_view messageId );
+
+ private:
+  std::size_t findSlot( std::uint64_t hash ) const;
+  void        erase( std::uint64_t hash );
+
+  std::vector<std::uint64_t> ring_;    // hashes in arrival order
+  std::size_t                next_;    // where the next hash goes in the ring
+  std::size_t                count_;   // how many of the ring's slots are in use
+  std::vector<std::uint64_t> table_;   // 0 marks an empty slot
+  std::size_t                mask_;
+};
@@ -0,0 +1,394 @@
+#include "StompFrame.h"
+#include "StompScan.h"
+#include <cstring>
+#include <charconv>
+
+std::string_view StompFrame::header( std::string_view name ) const
+{
+  StompHeader wellKnown = lookupHeader( name );
+  if( wellKnown != HEADER_UNKNOWN )
+  {
+    return known[ wellKnown ];
+  }
+
+  for( const auto& entry : custom )
+  {
+    if( entry.first == name )
+    {
+      return entry.second;
+    }
+  }
+  return std::string_view();
+}
+
+void StompFrame::clear()
+{
+  command = std::string_view();
+  body    = std::string_view();
+  for( std::size_t i = 0; i < HEADER_COUNT; ++i )
+  {
+    known[ i ] = std::string_view();
+  }
+  custom.clear();
+}
+
+StompMessage::StompMessage()
+  : frame_( std::pmr::new_delete_resource() )
+{
+}
+
+// Copy a view into the next free space in a message's storage.
+static std::string_view copyInto( char*& next, std::string_view text )
+{
+  std::memcpy( next, text.data(), text.size() );
+  std::string_view copy( next, text.size() );
+  next += text.size();
+  return copy;
+}
+
+StompMessage StompFrame::retain() const
+{
+  // Work out how much room everything needs, so it can go in one block.
+  std::size_t size = command.size() + body.size();
+  for( std::size_t i = 0; i < HEADER_COUNT; ++i )
+  {
+    size += known[ i ].size();
+  }
+  for( const auto& entry : custom )
+  {
+    size += entry.first.size() + entry.second.size();
+  }
+
+  StompMessage message;
+  message.storage_.reset( new char[ size ] );
+  char* next = message.storage_.get();
+
+  StompFrame& copy = message.frame_;
+  copy.command = copyInto( next, command );
+  copy.body    = copyInto( next, body );
+  for( std::size_t i = 0; i < HEADER_COUNT; ++i )
+  {
+    if( has( static_cast<StompHeader>( i ) ) )
+    {
+      copy.known[ i ] = copyInto( next, known[ i ] );
+    }
+  }
+  copy.custom.reserve( custom.size() );
+  for( const auto& entry : custom )
+  {
+    std::string_view name = copyInto( next, entry.first );
+    copy.custom.emplace_back( name, copyInto( next, entry.second ) );
+  }
+
+  return message;
+}
+
+// Unescape the text from read up to the next ':', EOL or NUL, writing it back
+// at write. Since an escape sequence is always longer than the character it
+// stands for, write never overtakes read. Returns a pointer to the delimiter
+// that stopped the scan and advances write past the unescaped text, or NULL
+// if there is an undefined escape sequence, which STOMP treats as fatal.
+static char* unescapeUntilDelimiter( char* read, char* end, bool stopAtColon, bool unescape, char*& write )
+{
+  char* p = read;
+  while( p < end )
+  {
+    char* delimiter = const_cast<char*>( scanHeaderDelimiter( p, end ) );
+    if( write != p )
+    {
+      std::memmove( write, p, delimiter - p );
+    }
+    write += delimiter - p;
+    if( delimiter == end || *delimiter == '\n' || *delimiter == '\0' )
+    {
+      return delimiter;
+    }
+
+    if( *delimiter == ':' )
+    {
+      if( stopAtColon )
+      {
+	return delimiter;
+      }
+
+      // Only the first colon separates the name from the value.
+      *write++ = ':';
+      p = delimiter + 1;
+      continue;
+    }
+
+    // This is a backslash.
+    if( !unescape || delimiter + 1 == end )
+    {
+      *write++ = '\\';
+      p = delimiter + 1;
+      continue;
+    }
+
+    switch( delimiter[ 1 ] )
+    {
+    case 'n':  *write++ = '\n';  break;
+    case 'r':  *write++ = '\r';  break;
+    case 'c':  *write++ = ':';   break;
+    case '\\': *write++ = '\\'; break;
+    default:
+      // Including a backslash in front of the EOL or NUL, which must not be
+      // stepped over.
+      return NULL;
+    }
+    p = delimiter + 2;
+  }
+  return end;
+}
+
+// Drop an optional '\r' from the end of a line.
+static inline std::string_view stripCarriageReturn( char* begin, char* end )
+{
+  if( end > begin && end[ -1 ] == '\r' )
+  {
+    --end;
+  }
+  return std::string_view( begin, end - begin );
+}
+
+bool parseFrameHead( char* text, std::size_t length, StompVersion version, StompFrame& frame, std::size_t& headLength )
+{
+  char* p   = text;
+  char* end = text + length;
+
+  frame.clear();
+
+  // Skip over any heart-beat EOLs in front of the frame.
+  while( p < end && ( *p == '\n' || *p == '\r' ) )
+  {
+    ++p;
+  }
+
+  // The command is the first line.
+  char* eol = const_cast<char*>( scanNewline( p, end ) );
+  if( eol == end )
+  {
+    return false;
+  }
+  frame.command = stripCarriageReturn( p, eol );
+  p = eol + 1;
+
+  // CONNECT and CONNECTED frames never escape their headers, nor does 1.0.
+  bool unescape = version != STOMP_1_0 && frame.command != "CONNECT" && frame.command != "CONNECTED";
+
+  // Now the headers, up to an empty line.
+  for( ;; )
+  {
+    if( p == end )
+    {
+      return false;
+    }
+    if( *p == '\n' )
+    {
+      ++p;
+      break;
+    }
+    if( *p == '\r' && p + 1 < end && p[ 1 ] == '\n' )
+    {
+      p += 2;
+      break;
+    }
+
+    char* write     = p;
+    char* nameStart = write;
+    char* delimiter = unescapeUntilDelimiter( p, end, true, unescape, write );
+    if( delimiter == NULL || delimiter == end || *delimiter != ':' )
+    {
+      return false;
+    }
+    std::string_view name( nameStart, write - nameStart );
+
+    char* valueStart = write;
+    char* rawValue   = delimiter + 1;
+    delimiter = unescapeUntilDelimiter( rawValue, end, false, unescape, write );
+    if( delimiter == NULL || delimiter == end || *delimiter != '\n' )
+    {
+      return false;
+    }
+
+    // Only a raw '\r' in front of the '\n' is part of the EOL; an escaped one
+    // belongs to the value.
+    if( delimiter > rawValue && delimiter[ -1 ] == '\r' )
+    {
+      --write;
+    }
+    std::string_view value( valueStart, write - valueStart );
+    p = delimiter + 1;
+
+    // If a header is repeated, only the first one counts.
+    StompHeader wellKnown = lookupHeader( name );
+    if( wellKnown != HEADER_UNKNOWN )
+    {
+      if( !frame.has( wellKnown ) )
+      {
+	frame.known[ wellKnown ] = value;
+      }
+    }
+    else if( frame.header( name ).data() == NULL )
+    {
+      frame.custom.emplace_back( name, value );
+    }
+  }
+
+  headLength = p - text;
+  return true;
+}
+
+bool parseFrame( char* text, std::size_t length, StompVersion version, StompFrame& frame )
+{
+  std::size_t headLength;
+  if( !parseFrameHead( text, length, version, frame, headLength ) )
+  {
+    return false;
+  }
+  char* p   = text + headLength;
+  char* end = text + length;
+
+  // The body runs for content-length bytes if we were told it, otherwise up
+  // to the NUL (or the end of the text we were given).
+  if( frame.has( HEADER_CONTENT_LENGTH ) )
+  {
+    std::string_view contentLength = frame.header( HEADER_CONTENT_LENGTH );
+    std::size_t      bodyLength    = 0;
+    auto parsed = std::from_chars( contentLength.data(), contentLength.data() + contentLength.size(), bodyLength );
+    if( parsed.ec != std::errc() || bodyLength > static_cast<std::size_t>( end - p ) )
+    {
+      return false;
+    }
+    frame.body = std::string_view( p, bodyLength );
+  }
+  else
+  {
+    frame.body = std::string_view( p, scanNul( p, end ) - p );
+  }
+
+  return true;
+}
+
+std::size_t findFrameEnd( char const* data, std::size_t length, std::size_t& skip )
+{
+  char const* end = data + length;
+
+  skip = 0;
+  while( skip < length && ( data[ skip ] == '\n' || data[ skip ] == '\r' ) )
+  {
+    ++skip;
+  }
+  char const* frame = data + skip;
+
+  // Walk the header lines looking for the blank one, noting the first
+  // content-length on the way.
+  static const char  CONTENT_LENGTH[]     = "content-length:";
+  static const std::size_t CONTENT_LENGTH_SIZE = sizeof( CONTENT_LENGTH ) - 1;
+  bool        haveLength = false;
+  std::size_t bodyLength = 0;
+  char const* line       = scanNewline( frame, end );
+  for( ;; )
+  {
+    if( line == end )
+    {
+      return 0;
+    }
+    line++;
+
+    char const* eol = scanNewline( line, end );
+    if( eol == end )
+    {
+      return 0;
+    }
+    if( eol == line || ( eol == line + 1 && *line == '\r' ) )
+    {
+      line = eol + 1;
+      break;
+    }
+
+    if( !haveLength && static_cast<std::size_t>( eol - line ) > CONTENT_LENGTH_SIZE &&
+	std::memcmp( line, CONTENT_LENGTH, CONTENT_LENGTH_SIZE ) == 0 )
+    {
+      haveLength = std::from_chars( line + CONTENT_LENGTH_SIZE, eol, bodyLength ).ec == std::errc();
+    }
+    line = eol;
+  }
+
+  // The body runs for content-length bytes, then the NUL. Without a length
+  // it runs up to the first NUL.
+  char const* nul;
+  if( haveLength )
+  {
+    if( static_cast<std::size_t>( end - line ) <= bodyLength )
+    {
+      return 0;
+    }
+    nul = line + bodyLength;
+  }
+  else
+  {
+    nul = scanNul( line, end );
+    if( nul == end )
+    {
+      return 0;
+    }
+  }
+  return nul + 1 - frame;
+}
+
+void appendEscaped( std::string& frame, char const* text, std::size_t length, StompVersion version )
+{
+  if( version == STOMP_1_0 )
+  {
+    frame.append( text, length );
+    return;
+  }
+
+  char const* p   = text;
+  char const* end = text + length;
+  while( p < end )
+  {
+    char const* special = scanEscapable( p, end );
+    frame.append( p, special - p );
+    if( special == end )
+    {
+      break;
+    }
+
+    switch( *special )
+    {
+    case '\n': frame += "\\n";  break;
+    case ':':  frame += "\\c";  break;
+    case '\\': frame += "\\\\"; break;
+    case '\r':
+      // 1.1 has no escape for a carriage return.
+      if( version == STOMP_1_2 )
+      {
+	frame += "\\r";
+      }
+      else
+      {
+	frame.push_back( '\r' );
+      }
+      break;
+    }
+    p = special + 1;
+  }
+}
+
+void appendHeader( std::string& frame, char const* name, char const* value, StompVersion version )
+{
+  appendEscaped( frame, name, std::strlen( name ), version );
+  frame.push_back( ':' );
+  appendEscaped( frame, value, std::strlen( value ), version );
+  frame += "\r\n";
+}
+
+void appendHeader( std::string& frame, char const* name, std::string_view value, StompVersion version )
+{
+  appendEscaped( frame, name, std::strlen( name ), version );
+  frame.push_back( ':' );
+  appendEscaped( frame, value.data(), value.size(), version );
+  frame += "\r\n";
+}
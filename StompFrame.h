@@ -0,0 +1,111 @@
+#pragma once
+
+// Standard includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <cstddef>
+
+// Well-known header names
+#include "StompHeaders.h"
+
+// On-demand access to JSON bodies
+#include "StompJson.h"
+
+// The protocol versions that change how a frame is encoded on the wire.
+enum StompVersion
+{
+  STOMP_1_0,   // no header escaping at all
+  STOMP_1_1,   // escapes '\n', ':' and '\\'
+  STOMP_1_2    // ... and '\r' as well
+};
+
+class StompMessage;
+
+// A received frame. Everything in it points into the buffer the frame was
+// read into (with the headers unescaped in place), and its custom header list
+// comes out of the connection's frame arena, so it is only valid for the
+// duration of the callback it is handed to. Use retain() to keep it longer.
+struct StompFrame
+{
+  explicit StompFrame( std::pmr::memory_resource* resource = std::pmr::get_default_resource() )
+    : custom( resource )
+  {
+  }
+
+  std::string_view command;
+  std::string_view body;
+
+  // The headers the protocol defines, indexed by StompHeader. A header the
+  // frame did not carry has a NULL data().
+  std::string_view known[ HEADER_COUNT ];
+
+  // Any other headers, in the order they arrived.
+  std::pmr::vector< std::pair<std::string_view, std::string_view> > custom;
+
+  // Does the frame have this header?
+  bool has( StompHeader name ) const { return known[ name ].data() != NULL; }
+
+  // Look up a header, returning an empty view if the frame does not have it.
+  std::string_view header( StompHeader name ) const { return known[ name ]; }
+  std::string_view header( std::string_view name ) const;
+
+  // Read fields out of a JSON body without parsing all of it.
+  StompJsonView json() const { return StompJsonView( body ); }
+
+  // Forget everything, ready to parse another frame.
+  void clear();
+
+  // Copy the frame onto the heap so it can outlive the callback.
+  StompMessage retain() const;
+};
+
+// A frame that owns its own copy of the text. The view it hands out stays
+// valid for as long as the message does, including across moves.
+class StompMessage
+{
+ public:
+  StompMessage();
+  StompMessage( StompMessage&& other ) = default;
+  StompMessage& operator=( StompMessage&& other ) = default;
+
+  const StompFrame& frame() const { return frame_; }
+
+ private:
+  friend struct StompFrame;
+
+  std::unique_ptr<char[]> storage_;
+  StompFrame              frame_;
+};
+
+// Handlers that want the whole frame rather than just the body. The context
+// pointer is whatever was passed in when the handler was registered.
+typedef void (*frameHandler)( const StompFrame& frame, void* context );
+
+// Split the text of a frame into its command, headers and body. Header names
+// and values are unescaped in place according to the given version, except in
+// CONNECT and CONNECTED frames, which are never escaped. Returns false if the
+// frame is malformed, which includes an undefined escape sequence.
+bool parseFrame( char* text, std::size_t length, StompVersion version, StompFrame& frame );
+
+// Parse just the command and headers, leaving the body empty, for when the
+// body has not all arrived yet. headLength is set to where the body starts.
+// Returns false if the headers are malformed or incomplete.
+bool parseFrameHead( char* text, std::size_t length, StompVersion version, StompFrame& frame, std::size_t& headLength );
+
+// Find the first complete frame in a stream of bytes, for transports that do
+// not frame messages for us. Any heart-beat EOLs in front of the frame are
+// counted in skip. Returns the length of the frame after those, including its
+// NUL, or 0 if more bytes are needed to complete it.
+std::size_t findFrameEnd( char const* data, std::size_t length, std::size_t& skip );
+
+// Append "name:value" and an EOL to a frame being built, escaping any special
+// characters in the name and value as the given version requires.
+void appendHeader( std::string& frame, char const* name, char const* value, StompVersion version );
+void appendHeader( std::string& frame, char const* name, std::string_view value, StompVersion version );
+
+// Append text to a frame with the escaping rules for the given version.
+void appendEscaped( std::string& frame, char const* text, std::size_t length, StompVersion version );
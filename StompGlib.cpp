@@ -0,0 +1,53 @@
+#include "StompGlib.h"
+
+StompGlibDispatcher::StompGlibDispatcher( batchHandler handler, void* context, guint intervalMs, GMainContext* mainContext )
+  : handler_( handler ), context_( context ), intervalMs_( intervalMs ), mainContext_( mainContext ), source_( NULL )
+{
+}
+
+StompGlibDispatcher::~StompGlibDispatcher()
+{
+  std::unique_lock<std::mutex> locker( g_queue );
+  if( source_ != NULL )
+  {
+    g_source_destroy( source_ );
+    g_source_unref( source_ );
+  }
+}
+
+void StompGlibDispatcher::queueFrame( const StompFrame& frame, void* dispatcher )
+{
+  static_cast<StompGlibDispatcher*>( dispatcher )->queue( frame );
+}
+
+void StompGlibDispatcher::queue( const StompFrame& frame )
+{
+  StompMessage message = frame.retain();
+
+  std::unique_lock<std::mutex> locker( g_queue );
+  pending_.push_back( std::move( message ) );
+
+  // The first message of a batch sets the clock going; the rest just join it.
+  if( source_ == NULL )
+  {
+    source_ = g_timeout_source_new( intervalMs_ );
+    g_source_set_callback( source_, flush, this, NULL );
+    g_source_attach( source_, mainContext_ );
+  }
+}
+
+// On the main loop: hand over everything queued since last time.
+gboolean StompGlibDispatcher::flush( gpointer dispatcher )
+{
+  StompGlibDispatcher* self = static_cast<StompGlibDispatcher*>( dispatcher );
+  {
+    std::unique_lock<std::mutex> locker( self->g_queue );
+    self->delivering_.swap( self->pending_ );
+    g_source_unref( self->source_ );
+    self->source_ = NULL;
+  }
+
+  self->handler_( self->delivering_, self->context_ );
+  self->delivering_.clear();
+  return G_SOURCE_REMOVE;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Standard includes
+#include <mutex>
+#include <vector>
+
+// GLib
+#include <glib.h>
+
+// Frames
+#include "StompFrame.h"
+
+// Handlers for batches of messages, called on the GLib main loop.
+typedef void (*batchHandler)( std::vector<StompMessage>& messages, void* context );
+
+// Moves messages from the io thread to a GLib main loop, which is the only
+// place a GTK program may touch its widgets. Messages are queued as they
+// come in, and handed over together at most once per interval, so a burst
+// of traffic costs the main loop one wake-up and one batch rather than one
+// of each per message.
+//
+// Use queueFrame as the client's frame handler, with the dispatcher as its
+// context. Destroy the dispatcher on the main loop's thread, once the client
+// has stopped delivering to it.
+class StompGlibDispatcher
+{
+ public:
+  // The default interval is about one frame at 60Hz. A NULL main context
+  // means the default one, which is what gtk_main() runs.
+  StompGlibDispatcher( batchHandler handler, void* context, guint intervalMs = 16, GMainContext* mainContext = NULL );
+  ~StompGlibDispatcher();
+
+  // Queue a copy of a frame. This can be called on any thread.
+  void        queue( const StompFrame& frame );
+  static void queueFrame( const StompFrame& frame, void* dispatcher );
+
+ private:
+  static gboolean flush( gpointer dispatcher );
+
+  batchHandler              handler_;
+  void                     *context_;
+  guint                     intervalMs_;
+  GMainContext             *mainContext_;
+
+  // The messages waiting for the main loop, and the source that will hand
+  // them over if one is already on its way; both guarded by g_queue.
+  std::mutex                g_queue;
+  std::vector<StompMessage> pending_;
+  GSource                  *source_;
+
+  // The batch being handed over. Only the main loop touches this.
+  std::vector<StompMessage> delivering_;
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+// Standard includes
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// The header names the protocol defines. The parser files these into fixed
+// slots on the frame so they can be read without any string comparisons.
+enum StompHeader
+{
+  HEADER_ACCEPT_VERSION,
+  HEADER_ACK,
+  HEADER_CONTENT_LENGTH,
+  HEADER_CONTENT_TYPE,
+  HEADER_CORRELATION_ID,
+  HEADER_DESTINATION,
+  HEADER_HEART_BEAT,
+  HEADER_HOST,
+  HEADER_ID,
+  HEADER_LOGIN,
+  HEADER_MESSAGE,
+  HEADER_MESSAGE_ID,
+  HEADER_PASSCODE,
+  HEADER_RECEIPT,
+  HEADER_RECEIPT_ID,
+  HEADER_REPLY_TO,
+  HEADER_SERVER,
+  HEADER_SESSION,
+  HEADER_STOMP_PRODUCER,
+  HEADER_STOMP_SEQUENCE,
+  HEADER_STOMP_TIMESTAMP,
+  HEADER_SUBSCRIPTION,
+  HEADER_TRANSACTION,
+  HEADER_VERSION,
+  HEADER_COUNT,
+  HEADER_UNKNOWN = HEADER_COUNT
+};
+
+// The wire names, in the same order as the enum.
+constexpr std::string_view stompHeaderNames[ HEADER_COUNT ] =
+{
+  "accept-version",
+  "ack",
+  "content-length",
+  "content-type",
+  "correlation-id",
+  "destination",
+  "heart-beat",
+  "host",
+  "id",
+  "login",
+  "message",
+  "message-id",
+  "passcode",
+  "receipt",
+  "receipt-id",
+  "reply-to",
+  "server",
+  "session",
+  "stomp-producer",
+  "stomp-sequence",
+  "stomp-timestamp",
+  "subscription",
+  "transaction",
+  "version"
+};
+
+// The perfect hash only looks at the length and three characters of the
+// name, so it costs the same however long the header is. The seed is found
+// at compile time by trying seeds until every known name lands in a slot of
+// its own.
+constexpr std::size_t HEADER_TABLE_SIZE = 64;
+
+constexpr std::uint32_t headerHash( std::uint32_t seed, const char* name, std::size_t length )
+{
+  std::uint32_t h = seed ^ static_cast<std::uint32_t>( length );
+  h = ( h ^ static_cast<unsigned char>( name[ 0 ] ) ) * 16777619u;
+  h = ( h ^ static_cast<unsigned char>( name[ length / 2 ] ) ) * 16777619u;
+  h = ( h ^ static_cast<unsigned char>( name[ length - 1 ] ) ) * 16777619u;
+  return ( h >> 16 ) % HEADER_TABLE_SIZE;
+}
+
+constexpr std::uint32_t findHeaderSeed()
+{
+  for( std::uint32_t seed = 2166136261u; seed < 2166136261u + 100000u; ++seed )
+  {
+    bool used[ HEADER_TABLE_SIZE ] = {};
+    bool collided = false;
+    for( std::size_t i = 0; i < HEADER_COUNT && !collided; ++i )
+    {
+      std::uint32_t slot = headerHash( seed, stompHeaderNames[ i ].data(), stompHeaderNames[ i ].size() );
+      collided = used[ slot ];
+      used[ slot ] = true;
+    }
+    if( !collided )
+    {
+      return seed;
+    }
+  }
+  return 0;
+}
+
+constexpr std::uint32_t HEADER_SEED = findHeaderSeed();
+static_assert( HEADER_SEED != 0, "no perfect hash seed for the STOMP header names" );
+
+struct StompHeaderTable
+{
+  unsigned char slots[ HEADER_TABLE_SIZE ];
+};
+
+constexpr StompHeaderTable makeHeaderTable()
+{
+  StompHeaderTable table = {};
+  for( std::size_t i = 0; i < HEADER_TABLE_SIZE; ++i )
+  {
+    table.slots[ i ] = HEADER_UNKNOWN;
+  }
+  for( std::size_t i = 0; i < HEADER_COUNT; ++i )
+  {
+    table.slots[ headerHash( HEADER_SEED, stompHeaderNames[ i ].data(), stompHeaderNames[ i ].size() ) ] =
+      static_cast<unsigned char>( i );
+  }
+  return table;
+}
+
+constexpr StompHeaderTable stompHeaderTable = makeHeaderTable();
+
+// Map a header name to its enum, or HEADER_UNKNOWN for custom headers.
+constexpr StompHeader lookupHeader( std::string_view name )
+{
+  if( name.empty() )
+  {
+    return HEADER_UNKNOWN;
+  }
+  unsigned char candidate = stompHeaderTable.slots[ headerHash( HEADER_SEED, name.data(), name.size() ) ];
+  if( candidate == HEADER_UNKNOWN || stompHeaderNames[ candidate ] != name )
+  {
+    return HEADER_UNKNOWN;
+  }
+  return static_cast<StompHeader>( candidate );
+}
+
+static_assert( lookupHeader( "subscription" ) == HEADER_SUBSCRIPTION, "header table is broken" );
+static_assert( lookupHeader( "x-custom" ) == HEADER_UNKNOWN,          "header table is broken" );
@@ -0,0 +1,164 @@
+#include "StompJournal.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char JOURNAL_MAGIC[ 8 ] = { 'S', 'T', 'O', 'M', 'P', 'J', 'N', 'L' };
+
+// Each record is its length followed by the frame.
+typedef std::uint32_t recordLength;
+
+StompSpillJournal::StompSpillJournal()
+  : fd_( -1 ), header_( NULL ), data_( NULL ), mappedSize_( 0 ), drainOffset_( 0 )
+{
+}
+
+StompSpillJournal::~StompSpillJournal()
+{
+  close();
+}
+
+bool StompSpillJournal::open( const char* path, std::size_t capacity )
+{
+  close();
+
+  fd_ = ::open( path, O_RDWR | O_CREAT, 0600 );
+  if( fd_ < 0 )
+  {
+    return false;
+  }
+
+  // A journal left over from an earlier run keeps its own size.
+  struct stat status;
+  bool        existing = fstat( fd_, &status ) == 0 && static_cast<std::size_t>( status.st_size ) > sizeof( Header );
+  std::size_t size     = existing ? static_cast<std::size_t>( status.st_size ) : sizeof( Header ) + capacity;
+  if( !existing && ftruncate( fd_, size ) != 0 )
+  {
+    close();
+    return false;
+  }
+
+  void* mapping = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0 );
+  if( mapping == MAP_FAILED )
+  {
+    close();
+    return false;
+  }
+  mappedSize_ = size;
+  header_     = static_cast<Header*>( mapping );
+  data_       = static_cast<char*>( mapping ) + sizeof( Header );
+
+  // Start afresh unless the file really is a journal we can trust.
+  std::uint64_t room = size - sizeof( Header );
+  if( std::memcmp( header_->magic, JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) ) != 0 || header_->capacity != room ||
+      header_->readOffset > header_->writeOffset || header_->writeOffset > room )
+  {
+    std::memcpy( header_->magic, JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) );
+    header_->readOffset  = 0;
+    header_->writeOffset = 0;
+    header_->capacity    = room;
+  }
+  drainOffset_ = header_->readOffset;
+  return true;
+}
+
+void StompSpillJournal::close()
+{
+  if( header_ != NULL )
+  {
+    munmap( header_, mappedSize_ );
+  }
+  if( fd_ >= 0 )
+  {
+    ::close( fd_ );
+  }
+  fd_         = -1;
+  header_     = NULL;
+  data_       = NULL;
+  mappedSize_  = 0;
+  drainOffset_ = 0;
+}
+
+bool StompSpillJournal::empty() const
+{
+  return header_ == NULL || drainOffset_ == header_->writeOffset;
+}
+
+bool StompSpillJournal::append( const char* frame, std::size_t length )
+{
+  if( header_ == NULL )
+  {
+    return false;
+  }
+
+  std::size_t needed = sizeof( recordLength ) + length;
+  if( header_->writeOffset + needed > header_->capacity )
+  {
+    // Reclaim the space already drained from the front, if that helps.
+    std::size_t pending = header_->writeOffset - header_->readOffset;
+    if( pending + needed > header_->capacity )
+    {
+      return false;
+    }
+    std::memmove( data_, data_ + header_->readOffset, pending );
+    drainOffset_        -= header_->readOffset;
+    header_->readOffset  = 0;
+    header_->writeOffset = pending;
+  }
+
+  recordLength prefix = static_cast<recordLength>( length );
+  std::memcpy( data_ + header_->writeOffset, &prefix, sizeof( prefix ) );
+  std::memcpy( data_ + header_->writeOffset + sizeof( prefix ), frame, length );
+
+  // Only move the write offset once the record is all there.
+  header_->writeOffset += needed;
+  return true;
+}
+
+std::size_t StompSpillJournal::drain( std::string& batch, std::size_t maxBytes )
+{
+  std::size_t frames = 0;
+  std::size_t added  = 0;
+  while( !empty() )
+  {
+    recordLength length;
+    std::memcpy( &length, data_ + drainOffset_, sizeof( length ) );
+    if( frames > 0 && added + length > maxBytes )
+    {
+      break;
+    }
+
+    batch.append( data_ + drainOffset_ + sizeof( length ), length );
+    drainOffset_ += sizeof( length ) + length;
+    added += length;
+    ++frames;
+  }
+  return frames;
+}
+
+void StompSpillJournal::commit()
+{
+  if( header_ == NULL )
+  {
+    return;
+  }
+  header_->readOffset = drainOffset_;
+
+  // Once everything is out, start again from the front of the file.
+  if( header_->readOffset == header_->writeOffset )
+  {
+    header_->readOffset  = 0;
+    header_->writeOffset = 0;
+    drainOffset_         = 0;
+  }
+}
+
+void StompSpillJournal::rewind()
+{
+  if( header_ != NULL )
+  {
+    drainOffset_ = header_->readOffset;
+  }
+}
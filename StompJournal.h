@@ -0,0 +1,67 @@
+#pragma once
+
+// Standard includes
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// A store-and-forward journal for outbound frames, kept in a memory-mapped
+// file so that it costs no heap and survives the process going away.
+//
+// Frames are appended as length-prefixed records while they cannot be sent
+// (the connection is down, or the write queue is over its limit) and drained
+// in the order they were written once they can. Drained frames stay in the
+// file until commit() says they have been written; rewind() hands them out
+// again if the connection went first. The file is a fixed size, set when it
+// is opened; when it is full, append() fails rather than growing.
+//
+// The journal does no locking of its own.
+class StompSpillJournal
+{
+ public:
+  StompSpillJournal();
+  ~StompSpillJournal();
+
+  // Open (or create) the journal file with room for capacity bytes of
+  // records. Anything left in an existing file from an earlier run is kept
+  // and will be drained first. Returns false if the file cannot be mapped.
+  bool open( const char* path, std::size_t capacity );
+  void close();
+
+  bool isOpen() const { return data_ != NULL; }
+
+  // True if there is nothing left to drain. Drained frames that have not
+  // been committed do not count.
+  bool empty() const;
+
+  // Add a frame to the end of the journal. Returns false if there is no room.
+  bool append( const char* frame, std::size_t length );
+
+  // Move whole frames from the front of the journal onto the end of batch
+  // until adding the next one would take it past maxBytes (at least one frame
+  // is always moved). Returns the number of frames moved. The frames are
+  // copied, not removed.
+  std::size_t drain( std::string& batch, std::size_t maxBytes );
+
+  // Everything drained so far has been written, so remove it.
+  void commit();
+
+  // Drained frames that were never committed are drained again.
+  void rewind();
+
+ private:
+  // This sits at the front of the file.
+  struct Header
+  {
+    char          magic[ 8 ];
+    std::uint64_t readOffset;
+    std::uint64_t writeOffset;
+    std::uint64_t capacity;
+  };
+
+  int          fd_;
+  Header      *header_;
+  char        *data_;       // the records, just after the header
+  std::size_t  mappedSize_;
+  std::uint64_t drainOffset_; // how far drain() has got, from readOffset on
+};
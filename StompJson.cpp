@@ -0,0 +1,400 @@
+#include "StompJson.h"
+#include "StompScan.h"
+#include <charconv>
+
+StompJsonView::StompJsonView( std::string_view text )
+  : text_( text ), fieldCount_( 0 ), position_( 0 ), started_( false ), finished_( false )
+{
+}
+
+static inline bool isJsonSpace( char c )
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Find the closing quote of a string whose opening quote is just before from.
+// Returns the end of the text if the string is not terminated.
+static std::size_t skipString( std::string_view text, std::size_t from )
+{
+  char const* p   = text.data() + from;
+  char const* end = text.data() + text.size();
+  while( p < end )
+  {
+    p = scanFor< '"', '\\', '"', '"' >( p, end );
+    if( p == end || *p == '"' )
+    {
+      break;
+    }
+
+    // Step over the escaped character.
+    p += 2;
+  }
+  return p < end ? p - text.data() : text.size();
+}
+
+// Find the end of the object or array that opens at from. Only the one kind
+// of bracket needs counting, since anything well formed nests properly.
+template< char OPEN, char CLOSE >
+static std::size_t skipNested( std::string_view text, std::size_t from )
+{
+  char const* p     = text.data() + from + 1;
+  char const* end   = text.data() + text.size();
+  int         depth = 1;
+  while( p < end )
+  {
+    p = scanFor< '"', OPEN, CLOSE, '"' >( p, end );
+    if( p == end )
+    {
+      break;
+    }
+
+    if( *p == '"' )
+    {
+      p = text.data() + skipString( text, p + 1 - text.data() ) + 1;
+    }
+    else if( *p == OPEN )
+    {
+      ++depth;
+      ++p;
+    }
+    else if( --depth == 0 )
+    {
+      return p + 1 - text.data();
+    }
+    else
+    {
+      ++p;
+    }
+  }
+  return text.size();
+}
+
+bool StompJsonView::scanNext( Field& field ) const
+{
+  std::size_t size = text_.size();
+  auto skipSpace = [&]()
+  {
+    while( position_ < size && isJsonSpace( text_[ position_ ] ) )
+    {
+      ++position_;
+    }
+  };
+
+  if( finished_ )
+  {
+    return false;
+  }
+
+  skipSpace();
+  if( !started_ )
+  {
+    if( position_ == size || text_[ position_ ] != '{' )
+    {
+      finished_ = true;
+      return false;
+    }
+    started_ = true;
+    ++position_;
+    skipSpace();
+  }
+
+  if( position_ < size && text_[ position_ ] == ',' )
+  {
+    ++position_;
+    skipSpace();
+  }
+
+  // Anything other than the start of a key means we are done.
+  if( position_ == size || text_[ position_ ] != '"' )
+  {
+    finished_ = true;
+    return false;
+  }
+
+  std::size_t keyEnd = skipString( text_, position_ + 1 );
+  field.key = text_.substr( position_ + 1, keyEnd - position_ - 1 );
+  position_ = keyEnd + 1;
+
+  skipSpace();
+  if( position_ >= size || text_[ position_ ] != ':' )
+  {
+    finished_ = true;
+    return false;
+  }
+  ++position_;
+  skipSpace();
+  if( position_ == size )
+  {
+    finished_ = true;
+    return false;
+  }
+
+  std::size_t start = position_;
+  field.quoted = false;
+  switch( text_[ start ] )
+  {
+  case '"':
+    {
+      std::size_t valueEnd = skipString( text_, start + 1 );
+      field.value  = text_.substr( start + 1, valueEnd - start - 1 );
+      field.quoted = true;
+      position_    = valueEnd + 1;
+    }
+    break;
+
+  case '{':
+    position_   = skipNested< '{', '}' >( text_, start );
+    field.value = text_.substr( start, position_ - start );
+    break;
+
+  case '[':
+    position_   = skipNested< '[', ']' >( text_, start );
+    field.value = text_.substr( start, position_ - start );
+    break;
+
+  default:
+    // A number or a literal runs until the next separator.
+    while( position_ < size && text_[ position_ ] != ',' && text_[ position_ ] != '}' && !isJsonSpace( text_[ position_ ] ) )
+    {
+      ++position_;
+    }
+    field.value = text_.substr( start, position_ - start );
+    break;
+  }
+
+  return true;
+}
+
+const StompJsonView::Field* StompJsonView::find( std::string_view key ) const
+{
+  // Have we already walked past it?
+  for( std::size_t i = 0; i < fieldCount_; ++i )
+  {
+    if( fields_[ i ].key == key )
+    {
+      return &fields_[ i ];
+    }
+  }
+
+  // Once the index has filled up, fields beyond it are found by walking the
+  // rest of the object again from the end of the index.
+  bool        full     = fieldCount_ == MAX_INDEXED_FIELDS;
+  std::size_t resumeAt = position_;
+  bool        wasDone  = finished_;
+
+  const Field* found = NULL;
+  Field        next;
+  while( scanNext( next ) )
+  {
+    if( !full )
+    {
+      fields_[ fieldCount_++ ] = next;
+      if( fieldCount_ == MAX_INDEXED_FIELDS )
+      {
+	full     = true;
+	resumeAt = position_;
+	wasDone  = finished_;
+      }
+      if( next.key == key )
+      {
+	found = &fields_[ fieldCount_ - 1 ];
+	break;
+      }
+    }
+    else if( next.key == key )
+    {
+      overflow_ = next;
+      found     = &overflow_;
+      break;
+    }
+  }
+
+  if( full )
+  {
+    position_ = resumeAt;
+    finished_ = wasDone;
+  }
+  return found;
+}
+
+std::string_view StompJsonView::raw( std::string_view key ) const
+{
+  const Field* field = find( key );
+  return field != NULL ? field->value : std::string_view();
+}
+
+bool StompJsonView::isString( std::string_view key ) const
+{
+  const Field* field = find( key );
+  return field != NULL && field->quoted;
+}
+
+// Append a code point to a string as UTF-8.
+static void appendUtf8( std::string& out, unsigned long codePoint )
+{
+  if( codePoint < 0x80 )
+  {
+    out.push_back( static_cast<char>( codePoint ) );
+  }
+  else if( codePoint < 0x800 )
+  {
+    out.push_back( static_cast<char>( 0xC0 | ( codePoint >> 6 ) ) );
+    out.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+  }
+  else if( codePoint < 0x10000 )
+  {
+    out.push_back( static_cast<char>( 0xE0 | ( codePoint >> 12 ) ) );
+    out.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) ) );
+    out.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+  }
+  else
+  {
+    out.push_back( static_cast<char>( 0xF0 | ( codePoint >> 18 ) ) );
+    out.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 12 ) & 0x3F ) ) );
+    out.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) ) );
+    out.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+  }
+}
+
+// Read the four hex digits of a \u escape.
+static bool parseHex4( std::string_view text, std::size_t at, unsigned long& value )
+{
+  if( at + 4 > text.size() )
+  {
+    return false;
+  }
+  unsigned int digits = 0;
+  auto parsed = std::from_chars( text.data() + at, text.data() + at + 4, digits, 16 );
+  value = digits;
+  return parsed.ec == std::errc() && parsed.ptr == text.data() + at + 4;
+}
+
+bool StompJsonView::getString( std::string_view key, std::string& value ) const
+{
+  const Field* field = find( key );
+  if( field == NULL || !field->quoted )
+  {
+    return false;
+  }
+
+  std::string_view raw = field->value;
+  std::string      decoded;
+  decoded.reserve( raw.size() );
+
+  char const* p   = raw.data();
+  char const* end = raw.data() + raw.size();
+  while( p < end )
+  {
+    char const* escape = scanFor< '\\', '\\', '\\', '\\' >( p, end );
+    decoded.append( p, escape - p );
+    if( escape == end || escape + 1 == end )
+    {
+      break;
+    }
+
+    p = escape + 2;
+    switch( escape[ 1 ] )
+    {
+    case 'b': decoded.push_back( '\b' ); break;
+    case 'f': decoded.push_back( '\f' ); break;
+    case 'n': decoded.push_back( '\n' ); break;
+    case 'r': decoded.push_back( '\r' ); break;
+    case 't': decoded.push_back( '\t' ); break;
+    case 'u':
+      {
+	unsigned long codePoint = 0;
+	std::size_t   at        = p - raw.data();
+	if( !parseHex4( raw, at, codePoint ) )
+	{
+	  return false;
+	}
+	p += 4;
+
+	// Characters outside the BMP come as a surrogate pair.
+	unsigned long low = 0;
+	if( codePoint >= 0xD800 && codePoint < 0xDC00 && p + 6 <= end && p[ 0 ] == '\\' && p[ 1 ] == 'u' &&
+	    parseHex4( raw, at + 6, low ) && low >= 0xDC00 && low < 0xE000 )
+	{
+	  codePoint = 0x10000 + ( ( codePoint - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+	  p += 6;
+	}
+	appendUtf8( decoded, codePoint );
+      }
+      break;
+    default:
+      // \" \\ and \/ all stand for themselves.
+      decoded.push_back( escape[ 1 ] );
+      break;
+    }
+  }
+
+  value.swap( decoded );
+  return true;
+}
+
+bool StompJsonView::getNumber( std::string_view key, double& value ) const
+{
+  const Field* field = find( key );
+  if( field == NULL || field->quoted )
+  {
+    return false;
+  }
+
+  double number = 0;
+  auto parsed = std::from_chars( field->value.data(), field->value.data() + field->value.size(), number );
+  if( parsed.ec != std::errc() || parsed.ptr != field->value.data() + field->value.size() )
+  {
+    return false;
+  }
+  value = number;
+  return true;
+}
+
+bool StompJsonView::getInteger( std::string_view key, long long& value ) const
+{
+  const Field* field = find( key );
+  if( field == NULL || field->quoted )
+  {
+    return false;
+  }
+
+  long long number = 0;
+  auto parsed = std::from_chars( field->value.data(), field->value.data() + field->value.size(), number );
+  if( parsed.ec != std::errc() || parsed.ptr != field->value.data() + field->value.size() )
+  {
+    return false;
+  }
+  value = number;
+  return true;
+}
+
+bool StompJsonView::getBool( std::string_view key, bool& value ) const
+{
+  const Field* field = find( key );
+  if( field == NULL || field->quoted )
+  {
+    return false;
+  }
+
+  if( field->value == "true" )
+  {
+    value = true;
+    return true;
+  }
+  if( field->value == "false" )
+  {
+    value = false;
+    return true;
+  }
+  return false;
+}
+
+StompJsonView StompJsonView::getObject( std::string_view key ) const
+{
+  const Field* field = find( key );
+  if( field == NULL || field->quoted || field->value.empty() || field->value[ 0 ] != '{' )
+  {
+    return StompJsonView( std::string_view() );
+  }
+  return StompJsonView( field->value );
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Standard includes
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// A read-only view of a JSON object that finds fields on demand. Nothing is
+// parsed up front: the first lookup walks the top level of the object only as
+// far as the field it wants, remembering where each field it passed starts so
+// that later lookups do not have to walk over them again. Nested objects and
+// arrays are skipped over rather than parsed, and values are handed back as
+// views into the original text, so a lookup never allocates.
+//
+// The view does not own the text, so it is only valid for as long as the text
+// is (for a received frame, the duration of the callback).
+class StompJsonView
+{
+ public:
+  explicit StompJsonView( std::string_view text );
+
+  // The raw text of a top-level field's value. Strings come back without their
+  // quotes but with any escapes left in; objects and arrays come back whole.
+  // A missing field gives a view with a NULL data().
+  std::string_view raw( std::string_view key ) const;
+
+  // Typed accessors. Each returns false if the field is missing or is not of
+  // the right type, leaving value untouched.
+  bool getString( std::string_view key, std::string& value ) const;
+  bool getNumber( std::string_view key, double& value ) const;
+  bool getInteger( std::string_view key, long long& value ) const;
+  bool getBool( std::string_view key, bool& value ) const;
+
+  // A nested object, as a view of its own.
+  StompJsonView getObject( std::string_view key ) const;
+
+  // Was the field a string? (raw() cannot tell "1" from 1.)
+  bool isString( std::string_view key ) const;
+
+ private:
+  struct Field
+  {
+    std::string_view key;     // still escaped, without quotes
+    std::string_view value;   // as raw() returns it
+    bool             quoted;
+  };
+
+  // Walk forward from where the last lookup stopped until we find key or run
+  // out of object.
+  const Field* find( std::string_view key ) const;
+  bool         scanNext( Field& field ) const;
+
+  // The fields found so far. Objects with more top-level fields than this
+  // still work; the extra fields are just not remembered.
+  static const std::size_t MAX_INDEXED_FIELDS = 32;
+
+  std::string_view    text_;
+  mutable Field       fields_[ MAX_INDEXED_FIELDS ];
+  mutable std::size_t fieldCount_;
+  mutable std::size_t position_;    // where scanning picks up again
+  mutable bool        started_;     // have we stepped past the '{' yet?
+  mutable bool        finished_;    // have we reached the '}'?
+  mutable Field       overflow_;    // the last field found beyond the index
+};
@@ -0,0 +1,110 @@
+#include "StompLatency.h"
+
+StompLatencyHistogram::StompLatencyHistogram()
+{
+  reset();
+}
+
+void StompLatencyHistogram::reset()
+{
+  for( std::atomic<std::uint64_t>& count : counts_ )
+  {
+    count.store( 0, std::memory_order_relaxed );
+  }
+}
+
+// Small values get a bucket each; above that, the top bit picks the power of
+// two and the next SUB_BUCKET_BITS bits the bucket within it.
+int StompLatencyHistogram::bucketOf( std::uint64_t value )
+{
+  if( value < SUB_BUCKETS )
+  {
+    return static_cast<int>( value );
+  }
+  int top   = 63 - __builtin_clzll( value );
+  int shift = top - SUB_BUCKET_BITS;
+  return ( shift + 1 ) * SUB_BUCKETS + static_cast<int>( ( value >> shift ) & ( SUB_BUCKETS - 1 ) );
+}
+
+std::int64_t StompLatencyHistogram::bucketTop( int bucket )
+{
+  if( bucket < SUB_BUCKETS )
+  {
+    return bucket;
+  }
+  int           shift  = bucket / SUB_BUCKETS - 1;
+  std::uint64_t bottom = static_cast<std::uint64_t>( SUB_BUCKETS + bucket % SUB_BUCKETS ) << shift;
+  std::uint64_t top    = bottom + ( ( std::uint64_t( 1 ) << shift ) - 1 );
+  return top > INT64_MAX ? INT64_MAX : static_cast<std::int64_t>( top );
+}
+
+void StompLatencyHistogram::record( std::int64_t nanoseconds )
+{
+  std::uint64_t value = nanoseconds > 0 ? static_cast<std::uint64_t>( nanoseconds ) : 0;
+  counts_[ bucketOf( value ) ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+std::uint64_t StompLatencyHistogram::count() const
+{
+  std::uint64_t total = 0;
+  for( const std::atomic<std::uint64_t>& count : counts_ )
+  {
+    total += count.load( std::memory_order_relaxed );
+  }
+  return total;
+}
+
+std::int64_t StompLatencyHistogram::percentile( double fraction ) const
+{
+  std::uint64_t total = count();
+  if( total == 0 )
+  {
+    return 0;
+  }
+
+  // The rank of the value we want, counting from 1.
+  double        wanted = fraction * static_cast<double>( total );
+  std::uint64_t rank   = wanted < 1 ? 1 : static_cast<std::uint64_t>( wanted + 0.999999 );
+  std::uint64_t seen   = 0;
+  for( int bucket = 0; bucket < BUCKETS; bucket++ )
+  {
+    seen += counts_[ bucket ].load( std::memory_order_relaxed );
+    if( seen >= rank )
+    {
+      return bucketTop( bucket );
+    }
+  }
+  return INT64_MAX;
+}
+
+std::uint64_t StompSequenceTracker::observe( std::string_view producer, std::string_view destination, std::uint64_t sequence )
+{
+  // One key for the pair; the buffer is reused so this does not allocate
+  // once it has grown.
+  key_.assign( producer.data(), producer.size() );
+  key_ += '\n';
+  key_.append( destination.data(), destination.size() );
+
+  auto found = expected_.find( key_ );
+  if( found == expected_.end() )
+  {
+    expected_.emplace( key_, sequence + 1 );
+    return 0;
+  }
+
+  std::uint64_t expected = found->second;
+  if( sequence < expected )
+  {
+    ++backwards_;
+    return 0;
+  }
+
+  found->second = sequence + 1;
+  if( sequence == expected )
+  {
+    return 0;
+  }
+  ++gaps_;
+  missing_ += sequence - expected;
+  return sequence - expected;
+}
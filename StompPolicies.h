@@ -0,0 +1,325 @@
+#pragma once
+
+// Standard includes
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <pthread.h>
+
+// Imports from boost/asio
+#include <boost/asio/io_context.hpp>
+
+// Frames and their handlers
+#include "StompFrame.h"
+
+namespace net = boost::asio;
+
+// How the io thread waits for something to do.
+enum StompRunMode
+{
+  STOMP_RUN_BLOCKING,     // the default: sleep in the kernel until there is work
+  STOMP_RUN_BUSY_POLL     // spin polling for work, trading a core for latency
+};
+
+// The policies a BasicStompClient is built from. Each is chosen at compile
+// time, so whatever a policy leaves out costs nothing at run time.
+
+// Logger policies: where the client's progress and trouble reports go.
+struct StompConsoleLogger
+{
+  template< class... Parts > static void info( const Parts&... parts )  { ( std::cout << ... << parts ) << std::endl; }
+  template< class... Parts > static void error( const Parts&... parts ) { ( std::cerr << ... << parts ) << std::endl; }
+};
+
+struct StompNullLogger
+{
+  template< class... Parts > static void info( const Parts&... parts )  {}
+  template< class... Parts > static void error( const Parts&... parts ) {}
+};
+
+// Executor policies: which thread runs the io_context, and so what the
+// client's state has to be guarded with and how a caller waits on it.
+
+// The io_context runs on a thread of the client's own, and the caller's
+// thread waits on condition variables for it.
+class StompThreadedExecutor
+{
+ public:
+  typedef std::mutex              mutex;
+  typedef std::shared_mutex       shared_mutex;
+  typedef std::condition_variable condition;
+
+  // Stop the io thread before what it works on goes. This joins the io
+  // thread, so it must not be called on it.
+  ~StompThreadedExecutor()
+  {
+    stop();
+  }
+
+  // Start running ioc, once the thread running the last one has finished.
+  template< class Logger >
+  void start( net::io_context& ioc, StompRunMode mode, int cpu )
+  {
+    stop();
+    ioc_ = &ioc;
+    thread_.reset( new std::thread( [&ioc, mode, cpu]()
+				    {
+				      if( cpu >= 0 )
+				      {
+					cpu_set_t cpus;
+					CPU_ZERO( &cpus );
+					CPU_SET( cpu, &cpus );
+					int error = pthread_setaffinity_np( pthread_self(), sizeof( cpus ), &cpus );
+					if( error != 0 )
+					{
+					  Logger::error( "IOCRunner: cannot pin to cpu ", cpu, ": ", std::strerror( error ) );
+					}
+				      }
+
+				      if( mode == STOMP_RUN_BUSY_POLL )
+				      {
+					// poll() never sleeps, so this picks work up as soon as it arrives.
+					while( !ioc.stopped() )
+					{
+					  ioc.poll();
+					}
+				      }
+				      else
+				      {
+					ioc.run();
+				      }
+				      Logger::info( "IOCRunner: exiting" );
+				    }) );
+  }
+
+  // Wait until done() is true or the timeout passes, returning done().
+  template< class Predicate >
+  bool waitFor( std::unique_lock<mutex>& locker, condition& check, std::chrono::milliseconds timeout, Predicate done )
+  {
+    return check.wait_for( locker, timeout, done );
+  }
+
+  // Wait for the next notification.
+  void wait( std::unique_lock<mutex>& locker, condition& check )
+  {
+    check.wait( locker );
+  }
+
+  // The io thread does the work, so there is nothing for the caller to do.
+  std::size_t poll() { return 0; }
+
+  // A future the caller can wait on. The io thread fulfils it.
+  template< class T >
+  std::future<T> waitable( std::future<T>&& pending ) { return std::move( pending ); }
+
+  // Wait for the io thread to run out of work.
+  void join()
+  {
+    if( thread_ && thread_->joinable() )
+    {
+      thread_->join();
+    }
+  }
+
+  // Stop the io_context and wait for the io thread to notice. The executor
+  // is done with the io_context after this, so it can be deleted.
+  void stop()
+  {
+    if( ioc_ != NULL )
+    {
+      ioc_->stop();
+      ioc_ = NULL;
+    }
+    join();
+  }
+
+ private:
+  net::io_context*             ioc_ = NULL;
+  std::unique_ptr<std::thread> thread_;
+};
+
+// For the inline executor, where nothing runs concurrently with the caller.
+struct StompNullMutex
+{
+  void lock()          {}
+  void unlock()        {}
+  bool try_lock()      { return true; }
+  void lock_shared()   {}
+  void unlock_shared() {}
+};
+
+struct StompInlineCondition
+{
+  bool notified = false;
+
+  void notify_one() { notified = true; }
+  void notify_all() { notified = true; }
+};
+
+// The io_context runs on the caller's thread: inside the calls that wait, and
+// in poll() and synchronize(). There are no other threads, so there is
+// nothing to lock. Everything, handlers included, runs on the one thread, and
+// the run mode and cpu are up to the caller. Conflation, which runs handlers
+// on a thread of their own, is not available with this.
+class StompInlineExecutor
+{
+ public:
+  typedef StompNullMutex       mutex;
+  typedef StompNullMutex       shared_mutex;
+  typedef StompInlineCondition condition;
+
+  template< class Logger >
+  void start( net::io_context& ioc, StompRunMode mode, int cpu )
+  {
+    ioc_ = &ioc;
+  }
+
+  template< class Predicate >
+  bool waitFor( std::unique_lock<mutex>& locker, condition& check, std::chrono::milliseconds timeout, Predicate done )
+  {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while( !done() && ioc_->run_one_until( deadline ) > 0 )
+    {
+    }
+    return done();
+  }
+
+  void wait( std::unique_lock<mutex>& locker, condition& check )
+  {
+    check.notified = false;
+    while( !check.notified && ioc_->run_one() > 0 )
+    {
+    }
+  }
+
+  // Run whatever is ready, without waiting.
+  std::size_t poll() { return ioc_ != NULL ? ioc_->poll() : 0; }
+
+  // A future the caller can wait on. Nothing else will run the io_context,
+  // so waiting on it runs the io_context until it is ready. If the io_context
+  // runs out of work first, it never will be, and the wait ends with T().
+  template< class T >
+  std::future<T> waitable( std::future<T>&& pending )
+  {
+    return std::async( std::launch::deferred, [this, pending = std::move( pending )]() mutable
+		       {
+			 while( pending.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+			 {
+			   if( ioc_->run_one() == 0 )
+			   {
+			     return T();
+			   }
+			 }
+			 return pending.get();
+		       });
+  }
+
+  // Run until there is no more work.
+  void join()
+  {
+    if( ioc_ != NULL )
+    {
+      ioc_->run();
+    }
+  }
+
+  void stop()
+  {
+    if( ioc_ != NULL )
+    {
+      ioc_->stop();
+      ioc_ = NULL;
+    }
+  }
+
+ private:
+  net::io_context* ioc_ = NULL;
+};
+
+// Allocation policies: where received frames are parsed into.
+
+// A per-connection arena, reset after every frame. Frames that need more
+// than the arena holds fall back to the heap.
+class StompArenaAllocation
+{
+ public:
+  void reset( std::size_t size )
+  {
+    storage_.reset( new std::byte[ size ] );
+    arena_.reset( new std::pmr::monotonic_buffer_resource( storage_.get(), size ) );
+  }
+
+  std::pmr::memory_resource* resource() { return arena_.get(); }
+  void                       release()  { arena_->release(); }
+
+ private:
+  std::unique_ptr<std::byte[]>                         storage_;
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> arena_;
+};
+
+// The heap, as for any other allocation. The arena size is not used.
+class StompHeapAllocation
+{
+ public:
+  void reset( std::size_t size ) {}
+
+  std::pmr::memory_resource* resource() { return std::pmr::new_delete_resource(); }
+  void                       release()  {}
+};
+
+// Handler policies: what a frame handler is, and how it is called.
+
+// A plain function, given the context it was registered with.
+struct StompPointerHandlers
+{
+  typedef frameHandler handler;
+
+  static bool empty( const handler& target )                                      { return target == NULL; }
+  static void call( const handler& target, const StompFrame& frame, void* context ) { target( frame, context ); }
+};
+
+// Anything callable, lambdas that capture their state included. The context
+// is passed along as well, for handlers written for the pointer signature.
+// Conflation is not available with these.
+struct StompFunctionHandlers
+{
+  typedef std::function<void( const StompFrame& frame, void* context )> handler;
+
+  static bool empty( const handler& target )                                      { return !target; }
+  static void call( const handler& target, const StompFrame& frame, void* context ) { target( frame, context ); }
+};
+
+// The policy sets. A set of your own can start from one of these and replace
+// some of its policies, but it needs instantiating at the end of
+// StompClient.cpp alongside them.
+
+// What StompClient has always done.
+struct StompDefaultPolicies
+{
+  typedef StompConsoleLogger    logger;
+  typedef StompThreadedExecutor executor;
+  typedef StompArenaAllocation  allocation;
+  typedef StompPointerHandlers  handlers;
+};
+
+// A single thread, no logging and frames parsed into the arena. The client
+// takes no locks of its own and logs nothing. The transports underneath are
+// shared with every other policy set, though: each read is still one virtual
+// call into the client, and the write queue still takes its mutex (which
+// nothing else contends for).
+struct StompLeanPolicies
+{
+  typedef StompNullLogger       logger;
+  typedef StompInlineExecutor   executor;
+  typedef StompArenaAllocation  allocation;
+  typedef StompPointerHandlers  handlers;
+};
@@ -0,0 +1,213 @@
+#include "StompRouter.h"
+#include <algorithm>
+
+template< class Policies >
+BasicStompRouter<Policies>::BasicStompRouter( BasicStompClient<Policies>& client )
+  : client_( client ), nextRouteId_( 1 )
+{
+}
+
+template< class Policies >
+BasicStompRouter<Policies>::~BasicStompRouter()
+{
+}
+
+// Patterns and destinations are both split on these.
+static inline bool isSeparator( char c )
+{
+  return c == '/' || c == '.';
+}
+
+// Peel the first segment off the front of text, skipping any separators in
+// front of it. Returns false when there are no segments left.
+static bool nextSegment( std::string_view& text, std::string_view& segment )
+{
+  std::size_t start = 0;
+  while( start < text.size() && isSeparator( text[ start ] ) )
+  {
+    ++start;
+  }
+  if( start == text.size() )
+  {
+    text = std::string_view();
+    return false;
+  }
+
+  std::size_t end = start;
+  while( end < text.size() && !isSeparator( text[ end ] ) )
+  {
+    ++end;
+  }
+
+  segment = text.substr( start, end - start );
+  text    = text.substr( end );
+  return true;
+}
+
+template< class Policies >
+void BasicStompRouter<Policies>::attach( int id, const char* destination, const char* ack )
+{
+  {
+    std::unique_lock<Mutex> locker( g_routes );
+    attached_.push_back( id );
+  }
+  client_.subscribe( id, destination, ack, onFrame, this );
+}
+
+template< class Policies >
+void BasicStompRouter<Policies>::detach()
+{
+  std::vector<int> ids;
+  {
+    std::unique_lock<Mutex> locker( g_routes );
+    ids.swap( attached_ );
+  }
+  for( int id : ids )
+  {
+    client_.unsubscribe( id );
+  }
+}
+
+template< class Policies >
+int BasicStompRouter<Policies>::route( const char* pattern, Handler handler, void* context )
+{
+  std::unique_lock<Mutex> locker( g_routes );
+
+  // Walk down the trie, adding nodes as we need them.
+  Node*            node = &root_;
+  std::string_view rest( pattern );
+  std::string_view segment;
+  while( nextSegment( rest, segment ) )
+  {
+    std::unique_ptr<Node>* next;
+    if( segment == "*" )
+    {
+      next = &node->anyOne;
+    }
+    else if( segment == "#" )
+    {
+      next = &node->anyMany;
+    }
+    else
+    {
+      auto found = node->children.find( segment );
+      if( found == node->children.end() )
+      {
+	found = node->children.emplace( std::string( segment ), std::unique_ptr<Node>() ).first;
+      }
+      next = &found->second;
+    }
+
+    if( !*next )
+    {
+      next->reset( new Node() );
+    }
+    node = next->get();
+  }
+
+  int routeId = nextRouteId_++;
+  node->routes.push_back( Route{ routeId, std::move( handler ), context } );
+  routeNodes_[ routeId ] = node;
+  return routeId;
+}
+
+template< class Policies >
+void BasicStompRouter<Policies>::unroute( int routeId )
+{
+  std::unique_lock<Mutex> locker( g_routes );
+
+  auto found = routeNodes_.find( routeId );
+  if( found == routeNodes_.end() )
+  {
+    return;
+  }
+
+  // The node itself stays in the trie, ready for the next route that wants it.
+  std::vector<Route>& routes = found->second->routes;
+  for( auto route = routes.begin(); route != routes.end(); ++route )
+  {
+    if( route->id == routeId )
+    {
+      routes.erase( route );
+      break;
+    }
+  }
+  routeNodes_.erase( found );
+}
+
+template< class Policies >
+void BasicStompRouter<Policies>::collect( const Node* node )
+{
+  matches_.insert( matches_.end(), node->routes.begin(), node->routes.end() );
+}
+
+// Find every route whose pattern matches what is left of the destination.
+template< class Policies >
+void BasicStompRouter<Policies>::match( const Node* node, std::string_view destination )
+{
+  // A "#" can swallow any number of the segments that are left, so try it
+  // against every suffix.
+  if( node->anyMany )
+  {
+    std::string_view suffix = destination;
+    std::string_view skipped;
+    match( node->anyMany.get(), suffix );
+    while( nextSegment( suffix, skipped ) )
+    {
+      match( node->anyMany.get(), suffix );
+    }
+  }
+
+  std::string_view segment;
+  if( !nextSegment( destination, segment ) )
+  {
+    collect( node );
+    return;
+  }
+
+  auto found = node->children.find( segment );
+  if( found != node->children.end() )
+  {
+    match( found->second.get(), destination );
+  }
+
+  if( node->anyOne )
+  {
+    match( node->anyOne.get(), destination );
+  }
+}
+
+// All of the router's broker subscriptions come through here.
+template< class Policies >
+void BasicStompRouter<Policies>::onFrame( const StompFrame& frame, void* context )
+{
+  BasicStompRouter* router = static_cast<BasicStompRouter*>( context );
+
+  // Find the handlers under the lock, but call them without it so that they
+  // are free to add and remove routes.
+  router->matches_.clear();
+  {
+    std::unique_lock<Mutex> locker( router->g_routes );
+    router->match( &router->root_, frame.header( HEADER_DESTINATION ) );
+  }
+
+  // A pattern with more than one "#" can match the same destination in
+  // more than one way, so each route is only called once, in the order the
+  // routes were added.
+  std::vector<Route>& matches = router->matches_;
+  if( matches.size() > 1 )
+  {
+    std::sort( matches.begin(), matches.end(), []( const Route& a, const Route& b ) { return a.id < b.id; } );
+    matches.erase( std::unique( matches.begin(), matches.end(), []( const Route& a, const Route& b ) { return a.id == b.id; } ),
+		   matches.end() );
+  }
+
+  for( const Route& route : router->matches_ )
+  {
+    Handlers::call( route.handler, frame, route.context );
+  }
+}
+
+// The same policy sets as the client's.
+template class BasicStompRouter<StompDefaultPolicies>;
+template class BasicStompRouter<StompLeanPolicies>;
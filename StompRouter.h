@@ -0,0 +1,89 @@
+#pragma once
+
+// Standard includes
+#include <string>
+#include <string_view>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+#include "StompClient.h"
+
+// Fans messages from a few broker subscriptions out to many local handlers.
+//
+// Rather than subscribing to hundreds of related destinations one by one,
+// attach() the router to a single broker-side wildcard destination (such as
+// "/topic/prices.>" on ActiveMQ or "/topic/prices.#" on RabbitMQ) and route()
+// local patterns onto handlers. Adding and removing routes is purely local;
+// nothing is sent to the broker.
+//
+// Patterns are split into segments on '/' and '.'. A "*" segment matches any
+// one segment and a "#" segment matches any number of them, including none:
+//
+//   /topic/prices.*        matches /topic/prices.IBM
+//   /topic/#               matches /topic/prices.IBM and /topic/news
+//
+// Each message's destination header is matched against a trie of the
+// patterns, so the cost depends on the depth of the destination rather than
+// the number of routes. Every matching route's handler is called once, in
+// the order the routes were added.
+//
+// A router works with a client built from the same policies, and its
+// handlers are that client's kind of handler.
+template< class Policies >
+class BasicStompRouter
+{
+ public:
+  typedef typename Policies::handlers          Handlers;
+  typedef typename Policies::handlers::handler Handler;
+  typedef typename Policies::executor::mutex   Mutex;
+
+  explicit BasicStompRouter( BasicStompClient<Policies>& client );
+  ~BasicStompRouter();
+
+  // Subscribe to a broker destination and route whatever arrives on it.
+  void attach( int id, const char* destination, const char* ack );
+
+  // Unsubscribe from everything we attached to.
+  void detach();
+
+  // Add a local route, returning an id that can be used to remove it.
+  int  route( const char* pattern, Handler handler, void* context = NULL );
+  void unroute( int routeId );
+
+ private:
+  struct Route
+  {
+    int      id;
+    Handler  handler;
+    void    *context;
+  };
+
+  struct Node
+  {
+    std::map< std::string, std::unique_ptr<Node>, std::less<> > children;
+    std::unique_ptr<Node>                                      anyOne;    // "*"
+    std::unique_ptr<Node>                                      anyMany;   // "#"
+    std::vector<Route>                                         routes;
+  };
+
+  static void onFrame( const StompFrame& frame, void* context );
+  void        match( const Node* node, std::string_view destination );
+  void        collect( const Node* node );
+
+  BasicStompClient<Policies>   &client_;
+  std::vector<int>              attached_;
+  Node                          root_;
+  std::unordered_map<int, Node*> routeNodes_;
+  int                           nextRouteId_;
+  Mutex                         g_routes;
+
+  // The routes that matched the frame being dispatched. Only touched on the
+  // io thread, and reused so that dispatch does not allocate.
+  std::vector<Route>            matches_;
+};
+
+typedef BasicStompRouter<StompDefaultPolicies> StompRouter;
+typedef BasicStompRouter<StompLeanPolicies>    StompLeanRouter;
@@ -0,0 +1,84 @@
+#include "StompRpc.h"
+#include <algorithm>
+
+StompPendingCalls::StompPendingCalls( std::chrono::milliseconds tick, std::size_t slots )
+  : wheel_( slots > 0 ? slots : 1 ), tick_( tick.count() > 0 ? tick : std::chrono::milliseconds( 1 ) ),
+    start_( std::chrono::steady_clock::now() ), now_( 0 ), nextId_( 1 )
+{
+}
+
+std::uint64_t StompPendingCalls::ticksAt( std::chrono::steady_clock::time_point when ) const
+{
+  return when <= start_ ? 0 : static_cast<std::uint64_t>( ( when - start_ ) / tick_ );
+}
+
+std::uint64_t StompPendingCalls::add( std::chrono::milliseconds timeout, replyHandler handler, void* context )
+{
+  // Round up, so no call times out early, and never into a slot already passed.
+  std::uint64_t deadline = ticksAt( std::chrono::steady_clock::now() + timeout + tick_ - std::chrono::milliseconds( 1 ) );
+  deadline = std::max( deadline, now_ + 1 );
+
+  std::uint64_t id = nextId_++;
+  calls_.emplace( id, Call{ handler, context, deadline } );
+  wheel_[ deadline % wheel_.size() ].push_back( id );
+  return id;
+}
+
+bool StompPendingCalls::take( std::uint64_t id, Call& call )
+{
+  auto found = calls_.find( id );
+  if( found == calls_.end() )
+  {
+    return false;
+  }
+  call = found->second;
+  calls_.erase( found );
+  return true;
+}
+
+void StompPendingCalls::expire( std::chrono::steady_clock::time_point now, std::vector<Call>& expired )
+{
+  std::uint64_t target = ticksAt( now );
+  if( target <= now_ )
+  {
+    return;
+  }
+
+  // Look at each slot passed since last time, but no slot more than once.
+  std::uint64_t passed = std::min<std::uint64_t>( target - now_, wheel_.size() );
+  for( std::uint64_t t = now_ + 1; t <= now_ + passed; t++ )
+  {
+    std::vector<std::uint64_t>& slot = wheel_[ t % wheel_.size() ];
+    std::size_t kept = 0;
+    for( std::uint64_t id : slot )
+    {
+      auto found = calls_.find( id );
+      if( found == calls_.end() )
+      {
+	continue;   // already answered
+      }
+      if( found->second.deadline > target )
+      {
+	slot[ kept++ ] = id;   // due on a later turn of the wheel
+	continue;
+      }
+      expired.push_back( found->second );
+      calls_.erase( found );
+    }
+    slot.resize( kept );
+  }
+  now_ = target;
+}
+
+void StompPendingCalls::takeAll( std::vector<Call>& taken )
+{
+  for( auto& entry : calls_ )
+  {
+    taken.push_back( entry.second );
+  }
+  calls_.clear();
+  for( std::vector<std::uint64_t>& slot : wheel_ )
+  {
+    slot.clear();
+  }
+}
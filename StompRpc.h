@@ -0,0 +1,65 @@
+#pragma once
+
+// Standard includes
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Frames
+#include "StompFrame.h"
+
+// Handlers for replies to requests. The reply is NULL if none came in time.
+typedef void (*replyHandler)( const StompFrame* reply, void* context );
+
+// The requests still waiting for a reply, keyed by correlation id.
+//
+// Finding the call a reply belongs to is a single hash lookup. Timeouts are
+// kept on a timer wheel: each call's id goes in the slot for the tick it
+// times out on, so expiring calls only looks at the slots the clock has
+// passed, however many calls there are. A call that is answered is simply
+// taken out of the table; its id is dropped from the wheel when its slot
+// next comes round. Calls further off than one turn of the wheel stay in
+// their slot until their tick arrives.
+//
+// This does no locking of its own.
+class StompPendingCalls
+{
+ public:
+  struct Call
+  {
+    replyHandler  handler;
+    void         *context;
+    std::uint64_t deadline;   // the tick the call times out on
+  };
+
+  explicit StompPendingCalls( std::chrono::milliseconds tick = std::chrono::milliseconds( 10 ),
+			      std::size_t slots = 512 );
+
+  // Add a call, returning its correlation id.
+  std::uint64_t add( std::chrono::milliseconds timeout, replyHandler handler, void* context );
+
+  // Take out the call with this id. Returns false if there is no such call,
+  // because it has already been answered or has timed out.
+  bool take( std::uint64_t id, Call& call );
+
+  // Take out every call that has timed out by now, adding them to expired.
+  void expire( std::chrono::steady_clock::time_point now, std::vector<Call>& expired );
+
+  // Take out every call, timed out or not, adding them to taken.
+  void takeAll( std::vector<Call>& taken );
+
+  bool                      empty() const { return calls_.empty(); }
+  std::chrono::milliseconds tick() const  { return tick_; }
+
+ private:
+  std::uint64_t ticksAt( std::chrono::steady_clock::time_point when ) const;
+
+  std::unordered_map<std::uint64_t, Call> calls_;
+  std::vector< std::vector<std::uint64_t> > wheel_;
+  std::chrono::milliseconds               tick_;
+  std::chrono::steady_clock::time_point   start_;
+  std::uint64_t                           now_;      // the last tick expired
+  std::uint64_t                           nextId_;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+// Standard includes
+#include <cstddef>
+
+// Vector intrinsics, when the compiler has been told they are available.
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+// These are the scanners used by the frame parser and the header encoders.
+// Each one returns a pointer to the first byte in [begin, end) that matches
+// any of the four template characters, or end if there is none. Pass the same
+// character more than once to look for fewer than four.
+//
+// The AVX2 path looks at 32 bytes at a time, the SSE2 path at 16, and the
+// scalar loop picks up whatever is left over (or everything, on machines
+// with neither).
+template< char A, char B, char C, char D >
+inline char const* scanFor( char const* begin, char const* end )
+{
+  char const* p = begin;
+
+#if defined( __AVX2__ )
+  const __m256i a32 = _mm256_set1_epi8( A );
+  const __m256i b32 = _mm256_set1_epi8( B );
+  const __m256i c32 = _mm256_set1_epi8( C );
+  const __m256i d32 = _mm256_set1_epi8( D );
+  while( end - p >= 32 )
+  {
+    __m256i chunk = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( p ) );
+    __m256i hits  = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( chunk, a32 ), _mm256_cmpeq_epi8( chunk, b32 ) ),
+				     _mm256_or_si256( _mm256_cmpeq_epi8( chunk, c32 ), _mm256_cmpeq_epi8( chunk, d32 ) ) );
+    unsigned mask = static_cast<unsigned>( _mm256_movemask_epi8( hits ) );
+    if( mask != 0 )
+    {
+      return p + __builtin_ctz( mask );
+    }
+    p += 32;
+  }
+#endif
+
+#if defined( __SSE2__ )
+  const __m128i a16 = _mm_set1_epi8( A );
+  const __m128i b16 = _mm_set1_epi8( B );
+  const __m128i c16 = _mm_set1_epi8( C );
+  const __m128i d16 = _mm_set1_epi8( D );
+  while( end - p >= 16 )
+  {
+    __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) );
+    __m128i hits  = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( chunk, a16 ), _mm_cmpeq_epi8( chunk, b16 ) ),
+				  _mm_or_si128( _mm_cmpeq_epi8( chunk, c16 ), _mm_cmpeq_epi8( chunk, d16 ) ) );
+    unsigned mask = static_cast<unsigned>( _mm_movemask_epi8( hits ) );
+    if( mask != 0 )
+    {
+      return p + __builtin_ctz( mask );
+    }
+    p += 16;
+  }
+#endif
+
+  for( ; p < end; ++p )
+  {
+    if( *p == A || *p == B || *p == C || *p == D )
+    {
+      return p;
+    }
+  }
+  return end;
+}
+
+// Find the end of the current line.
+inline char const* scanNewline( char const* begin, char const* end )
+{
+  return scanFor< '\n', '\n', '\n', '\n' >( begin, end );
+}
+
+// Find the next byte of interest while parsing a header line: the end of the
+// line, the name/value separator, an escape sequence or the end of the frame.
+inline char const* scanHeaderDelimiter( char const* begin, char const* end )
+{
+  return scanFor< '\n', ':', '\\', '\0' >( begin, end );
+}
+
+// Find the next byte that has to be escaped in a header name or value.
+inline char const* scanEscapable( char const* begin, char const* end )
+{
+  return scanFor< '\r', '\n', ':', '\\' >( begin, end );
+}
+
+// Find the NUL that terminates the frame body.
+inline char const* scanNul( char const* begin, char const* end )
+{
+  return scanFor< '\0', '\0', '\0', '\0' >( begin, end );
+}
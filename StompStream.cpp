@@ -0,0 +1,142 @@
+#include "StompStream.h"
+#include "StompScan.h"
+#include <algorithm>
+#include <charconv>
+
+StompStreamReader::StompStreamReader( websocketcallbacks& target, chunkHandler handler, void* context, std::size_t threshold )
+  : target_( target ), handler_( handler ), context_( context ), threshold_( threshold ),
+    state_( READING_FRAME ), start_( 0 ), haveLength_( false ), remaining_( 0 )
+{
+}
+
+void StompStreamReader::feed( char* data, std::size_t length, StompVersion version )
+{
+  while( length > 0 )
+  {
+    // Body bytes go straight to the handler without being copied.
+    if( state_ != READING_FRAME )
+    {
+      std::size_t used = feedBody( data, length );
+      data   += used;
+      length -= used;
+      continue;
+    }
+
+    buffer_.append( data, length );
+    length = 0;
+    drainBuffer( version );
+  }
+}
+
+// Hand on every complete frame in the buffer, and start streaming the one
+// after them if it has grown big enough.
+void StompStreamReader::drainBuffer( StompVersion version )
+{
+  while( state_ == READING_FRAME && start_ < buffer_.size() )
+  {
+    std::size_t skip   = 0;
+    std::size_t length = findFrameEnd( buffer_.data() + start_, buffer_.size() - start_, skip );
+    if( length > 0 )
+    {
+      target_.onRead( &buffer_[ start_ + skip ], length );
+      start_ += skip + length;
+      continue;
+    }
+    start_ += skip;
+
+    if( buffer_.size() - start_ < threshold_ || !startStreaming( version ) )
+    {
+      break;
+    }
+  }
+
+  // Keep whatever is left at the front of the buffer.
+  buffer_.erase( 0, start_ );
+  start_ = 0;
+}
+
+// Parse the headers of the frame at the front of the buffer, and pass on as
+// much of its body as has arrived. Returns false if the headers are not all
+// there yet. Headers that are all there but malformed drop the frame.
+bool StompStreamReader::startStreaming( StompVersion version )
+{
+  head_.assign( buffer_, start_, std::string::npos );
+  std::size_t headLength;
+  if( !parseFrameHead( &head_[ 0 ], head_.size(), version, frame_, headLength ) )
+  {
+    if( head_.find( "\n\n" ) == std::string::npos && head_.find( "\n\r\n" ) == std::string::npos )
+    {
+      return false;
+    }
+    state_ = DISCARDING;
+    start_ += feedBody( &buffer_[ start_ ], buffer_.size() - start_ );
+    return true;
+  }
+
+  std::string_view contentLength = frame_.header( HEADER_CONTENT_LENGTH );
+  haveLength_ = !contentLength.empty() &&
+		std::from_chars( contentLength.data(), contentLength.data() + contentLength.size(), remaining_ ).ec == std::errc();
+
+  // Shrinking the string leaves the headers where they are.
+  head_.resize( headLength );
+  start_ += headLength;
+  state_  = STREAMING_BODY;
+
+  // The rest of the buffer is body, and maybe the start of the next frame.
+  std::size_t used = feedBody( &buffer_[ start_ ], buffer_.size() - start_ );
+  start_ += used;
+  return true;
+}
+
+// Pass body bytes to the handler, returning how many were used.
+std::size_t StompStreamReader::feedBody( char* data, std::size_t length )
+{
+  if( state_ == SKIPPING_NUL )
+  {
+    state_ = READING_FRAME;
+    return 1;
+  }
+  if( length == 0 )
+  {
+    return 0;
+  }
+  if( state_ == DISCARDING )
+  {
+    std::size_t skipped = scanNul( data, data + length ) - data;
+    if( skipped == length )
+    {
+      return length;
+    }
+    state_ = READING_FRAME;
+    return skipped + 1;
+  }
+
+  std::size_t chunk;
+  bool        last;
+  if( haveLength_ )
+  {
+    chunk       = std::min( length, remaining_ );
+    remaining_ -= chunk;
+    last        = remaining_ == 0;
+  }
+  else
+  {
+    chunk = scanNul( data, data + length ) - data;
+    last  = chunk < length;
+  }
+
+  handler_( frame_, std::string_view( data, chunk ), last, context_ );
+  if( !last )
+  {
+    return chunk;
+  }
+
+  // Without a length the NUL has been found already.
+  if( haveLength_ )
+  {
+    state_ = SKIPPING_NUL;
+    return chunk + ( chunk < length ? feedBody( data + chunk, length - chunk ) : 0 );
+  }
+  state_ = READING_FRAME;
+  return chunk + 1;
+}
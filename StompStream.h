@@ -0,0 +1,59 @@
+#pragma once
+
+// Standard includes
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Frames, and where whole frames are delivered
+#include "StompFrame.h"
+#include "WebSocketCallbacks.h"
+
+// Handlers for frames that are streamed rather than buffered. The frame has
+// the command and headers but no body; the body arrives a chunk at a time,
+// with last set on the final chunk. The frame is valid until then; each chunk
+// only for the call it is passed to.
+typedef void (*chunkHandler)( const StompFrame& frame, std::string_view chunk, bool last, void* context );
+
+// Cuts a stream of bytes into frames without having to hold big ones in
+// memory. Frames that arrive complete, or that are still small, are buffered
+// and handed to the target's onRead() as usual. Once more than threshold
+// bytes of a frame's body are waiting, its headers are parsed and the body is
+// passed to the chunk handler straight out of the bytes being fed in, so
+// however big the frame, no more than about threshold bytes of it are kept.
+class StompStreamReader
+{
+ public:
+  StompStreamReader( websocketcallbacks& target, chunkHandler handler, void* context, std::size_t threshold );
+
+  // Take the next bytes off the connection.
+  void feed( char* data, std::size_t length, StompVersion version );
+
+ private:
+  void        drainBuffer( StompVersion version );
+  bool        startStreaming( StompVersion version );
+  std::size_t feedBody( char* data, std::size_t length );
+
+  enum State
+  {
+    READING_FRAME,    // buffering until the frame is complete or big enough to stream
+    STREAMING_BODY,   // handing body bytes to the chunk handler
+    SKIPPING_NUL,     // the body is done; the NUL that ends the frame is next
+    DISCARDING        // the headers were malformed, so the frame is dropped up to its NUL
+  };
+
+  websocketcallbacks& target_;
+  chunkHandler        handler_;
+  void               *context_;
+  std::size_t         threshold_;
+
+  State               state_;
+  std::string         buffer_;      // bytes not yet handed on
+  std::size_t         start_;       // where they start in the buffer
+
+  // The frame being streamed. Its headers point into head_.
+  std::string         head_;
+  StompFrame          frame_;
+  bool                haveLength_;
+  std::size_t         remaining_;   // body bytes still to come, if haveLength_
+};
@@ -0,0 +1,333 @@
+#include "StompTransport.h"
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// Constructor
+transport::transport( net::io_context& ioc, void (*errorFunction)(beast::error_code, char const*),
+		      websocketcallbacks *callbacks )
+  : executor_( ioc.get_executor() ), errorFunction_( errorFunction ), callbacks_( callbacks )
+{
+  // Start off with a few buffers ready to go.
+  for( int i = 0; i < 8; i++ )
+  {
+    bufferPool_.emplace_back();
+    bufferPool_.back().reserve( POOLED_BUFFER_SIZE );
+  }
+  messagesToSend.reserve( MAX_POOLED_BUFFERS );
+  messagesInFlight_.reserve( MAX_POOLED_BUFFERS );
+}
+
+// Destructor
+transport::~transport()
+{
+}
+
+void* handler_memory::allocate( std::size_t size )
+{
+  if( !inUse_ && size <= sizeof( storage_ ) )
+  {
+    inUse_ = true;
+    return &storage_;
+  }
+  return ::operator new( size );
+}
+
+void handler_memory::deallocate( void* pointer )
+{
+  if( pointer == &storage_ )
+  {
+    inUse_ = false;
+  }
+  else
+  {
+    ::operator delete( pointer );
+  }
+}
+
+// The connection is ready for frames, so let the client know.
+void transport::connected()
+{
+  callbacks_->onConnected();
+}
+
+// The connection has gone.
+void transport::disconnected( beast::error_code ec, char const *module )
+{
+  callbacks_->onDisconnect();
+  (*errorFunction_)( ec, module );
+}
+
+void transport::setSocketOptions( const StompSocketOptions& options )
+{
+  socketOptions_ = options;
+}
+
+void transport::setReadMessageMax( std::size_t bytes )
+{
+  readMessageMax_ = bytes;
+}
+
+void transport::setStreaming( bool streaming )
+{
+  streaming_ = streaming;
+}
+
+// Set an integer socket option, reporting failure to the client (but
+// otherwise ignoring it).
+static void setIntOption( int fd, int level, int name, int value, char const* module,
+			  void (*errorFunction)( beast::error_code ec, char const *module ) )
+{
+  if( setsockopt( fd, level, name, &value, sizeof( value ) ) != 0 )
+  {
+    errorFunction( beast::error_code( errno, beast::system_category() ), module );
+  }
+}
+
+void transport::tuneSocket( int fd, bool isTcp )
+{
+  tcpSocket_ = isTcp;
+  if( socketOptions_.receiveBuffer > 0 )
+  {
+    setIntOption( fd, SOL_SOCKET, SO_RCVBUF, socketOptions_.receiveBuffer, "setsockopt SO_RCVBUF", errorFunction_ );
+  }
+  if( socketOptions_.sendBuffer > 0 )
+  {
+    setIntOption( fd, SOL_SOCKET, SO_SNDBUF, socketOptions_.sendBuffer, "setsockopt SO_SNDBUF", errorFunction_ );
+  }
+#ifdef SO_BUSY_POLL
+  if( socketOptions_.busyPoll > 0 )
+  {
+    setIntOption( fd, SOL_SOCKET, SO_BUSY_POLL, socketOptions_.busyPoll, "setsockopt SO_BUSY_POLL", errorFunction_ );
+  }
+#endif
+
+  if( !isTcp )
+  {
+    return;
+  }
+  if( socketOptions_.noDelay )
+  {
+    setIntOption( fd, IPPROTO_TCP, TCP_NODELAY, 1, "setsockopt TCP_NODELAY", errorFunction_ );
+  }
+  rearmQuickAck( fd );
+}
+
+void transport::rearmQuickAck( int fd )
+{
+#ifdef TCP_QUICKACK
+  if( socketOptions_.quickAck && tcpSocket_ )
+  {
+    setIntOption( fd, IPPROTO_TCP, TCP_QUICKACK, 1, "setsockopt TCP_QUICKACK", errorFunction_ );
+  }
+#endif
+}
+
+// Clean up after a write operation
+void transport::on_write( beast::error_code ec, std::size_t bytes_transferred )
+{
+  //std::cout << "Sucessfully completed write operation" << std::endl;
+  boost::ignore_unused( bytes_transferred );
+
+  if( ec )
+  {
+    // Nothing more will get through, so drop the queue, close up, and
+    // leave the writer idle. Anything sent after this is dropped too.
+    std::vector<std::string> dropped;
+    {
+      std::unique_lock<std::mutex> locker( g_write );
+      writing_     = false;
+      writeFailed_ = true;
+      queuedBytes_ = 0;
+      dropped.swap( messagesToSend );
+      dropped.insert( dropped.end(), std::make_move_iterator( controlToSend_.begin() ),
+		      std::make_move_iterator( controlToSend_.end() ) );
+      controlToSend_.clear();
+      controlWaiting_ = false;
+    }
+    messagesInFlight_.clear();
+    controlInFlight_.clear();
+    nextToWrite_ = 0;
+    nextControl_ = 0;
+
+    abort_stream();
+    return (*errorFunction_)( ec, "write" );
+  }
+
+  std::vector<std::string>& lane = writingControl_ ? controlInFlight_ : messagesInFlight_;
+  std::size_t&              next = writingControl_ ? nextControl_ : nextToWrite_;
+  {
+    std::unique_lock<std::mutex> locker( g_write );
+    queuedBytes_ -= lane[ next ].size();
+  }
+
+  // Put the buffer back in the pool and move on to the next frame.
+  recycleBuffer( lane[ next++ ] );
+  write_next();
+}
+
+// Write the next waiting frame, if there is one. This only ever runs on the
+// io thread, with at most one write outstanding. Control frames go first.
+void transport::write_next()
+{
+  if( nextControl_ == controlInFlight_.size() && controlWaiting_ )
+  {
+    controlInFlight_.clear();
+    nextControl_ = 0;
+
+    std::unique_lock<std::mutex> locker( g_write );
+    controlInFlight_.swap( controlToSend_ );
+    controlWaiting_ = false;
+  }
+  writingControl_ = nextControl_ < controlInFlight_.size();
+  if( writingControl_ )
+  {
+    write_frame( controlInFlight_[ nextControl_ ] );
+    return;
+  }
+
+  if( nextToWrite_ == messagesInFlight_.size() )
+  {
+    messagesInFlight_.clear();
+    nextToWrite_ = 0;
+
+    // Pick up whatever has been sent since we last looked.
+    std::unique_lock<std::mutex> locker( g_write );
+    messagesInFlight_.swap( messagesToSend );
+    if( messagesInFlight_.empty() && controlWaiting_ )
+    {
+      // A control frame came in just now.
+      locker.unlock();
+      write_next();
+      return;
+    }
+    if( messagesInFlight_.empty() )
+    {
+      // Nothing left to do, so close up if we have been asked to.
+      writing_ = false;
+      bool closing = closeRequested_;
+      locker.unlock();
+      if( closing )
+      {
+	close_stream();
+	return;
+      }
+
+      // Let the client know there is room for more.
+      callbacks_->onWritable();
+      return;
+    }
+  }
+
+  write_frame( messagesInFlight_[ nextToWrite_ ] );
+}
+
+// Return a buffer to the pool, unless the pool is full or the buffer has
+// grown too big to be worth keeping around.
+void transport::recycleBuffer( std::string& buffer )
+{
+  std::unique_lock<std::mutex> locker( g_write );
+  if( bufferPool_.size() < MAX_POOLED_BUFFERS && buffer.capacity() <= 16 * POOLED_BUFFER_SIZE )
+  {
+    buffer.clear();
+    bufferPool_.push_back( std::move( buffer ) );
+  }
+  else
+  {
+    std::string().swap( buffer );
+  }
+}
+
+// Take a buffer from the pool, or make a new one if the pool is empty.
+std::string transport::acquireBuffer()
+{
+  std::unique_lock<std::mutex> locker( g_write );
+  if( bufferPool_.empty() )
+  {
+    locker.unlock();
+    std::string buffer;
+    buffer.reserve( POOLED_BUFFER_SIZE );
+    return buffer;
+  }
+
+  std::string buffer = std::move( bufferPool_.back() );
+  bufferPool_.pop_back();
+  return buffer;
+}
+
+// The handler that starts the writer on the io thread. Its memory comes from
+// the transport, so waking the writer up does not allocate.
+struct start_writer
+{
+  typedef handler_allocator<start_writer> allocator_type;
+
+  std::shared_ptr<transport> self;
+  handler_memory            *memory;
+
+  allocator_type get_allocator() const { return allocator_type( *memory ); }
+  void operator()() const { self->write_next(); }
+};
+
+// Post the writer onto the io thread. The caller has already marked it as
+// busy, so there is only ever one of these outstanding.
+void transport::wake_writer()
+{
+  net::post( executor_, start_writer{ shared_from_this(), &startWriteMemory_ } );
+}
+
+// Queue a finished frame. If the writer is idle it is woken up; otherwise it
+// will pick the frame up when it finishes what it is doing.
+void transport::send( std::string&& frame, StompLane lane )
+{
+  std::unique_lock<std::mutex> locker( g_write );
+  if( writeFailed_ )
+  {
+    return;
+  }
+  queuedBytes_ += frame.size();
+  if( lane == STOMP_LANE_CONTROL )
+  {
+    controlToSend_.push_back( std::move( frame ) );
+    controlWaiting_ = true;
+  }
+  else
+  {
+    messagesToSend.push_back( std::move( frame ) );
+  }
+  if( writing_ )
+  {
+    return;
+  }
+  writing_ = true;
+  locker.unlock();
+
+  wake_writer();
+}
+
+std::size_t transport::queuedBytes()
+{
+  std::unique_lock<std::mutex> locker( g_write );
+  return queuedBytes_;
+}
+
+// Drop the connection on the io thread.
+void transport::abort()
+{
+  net::post( executor_, [self = shared_from_this()]() { self->abort_stream(); } );
+}
+
+// Close the connection once everything queued so far has been written.
+void transport::close()
+{
+  std::unique_lock<std::mutex> locker( g_write );
+  closeRequested_ = true;
+  if( writing_ )
+  {
+    return;
+  }
+  writing_ = true;
+  locker.unlock();
+
+  wake_writer();
+}
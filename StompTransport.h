@@ -0,0 +1,205 @@
+#pragma once
+
+// Standard includes
+#include <string>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <type_traits>
+
+// Imports from boost/beast
+#include <boost/beast/core.hpp>
+
+// Callbacks into the client
+#include "WebSocketCallbacks.h"
+
+// Declare the namespaces
+namespace beast     = boost::beast;
+namespace net       = boost::asio;
+using     tcp       = boost::asio::ip::tcp;
+
+// What the transports do their I/O through. Only one thread ever runs the
+// io_context, so the io_context's own executor is used, with no strand. The
+// streams are given its type rather than left with their default, the
+// type-erased any_io_executor, which goes to the heap for every read and
+// write.
+using stomp_executor   = net::io_context::executor_type;
+using stomp_tcp_stream = beast::basic_stream<tcp, stomp_executor>;
+using stomp_resolver   = tcp::resolver::rebind_executor<stomp_executor>::other;
+
+// A single block of memory for the handler that wakes the writer up from
+// outside the io thread. Only one of those is ever outstanding, so this lets
+// us start writing without a trip to the heap.
+class handler_memory
+{
+ public:
+  void* allocate( std::size_t size );
+  void  deallocate( void* pointer );
+
+ private:
+  typename std::aligned_storage<256>::type storage_;
+  bool                                     inUse_ = false;
+};
+
+template< class T >
+struct handler_allocator
+{
+  typedef T value_type;
+
+  explicit handler_allocator( handler_memory& memory ) : memory_( memory ) {}
+  template< class U > handler_allocator( const handler_allocator<U>& other ) : memory_( other.memory_ ) {}
+
+  T*   allocate( std::size_t n )              { return static_cast<T*>( memory_.allocate( sizeof( T ) * n ) ); }
+  void deallocate( T* pointer, std::size_t )  { memory_.deallocate( pointer ); }
+
+  template< class U > bool operator==( const handler_allocator<U>& other ) const { return &memory_ == &other.memory_; }
+  template< class U > bool operator!=( const handler_allocator<U>& other ) const { return &memory_ != &other.memory_; }
+
+  handler_memory& memory_;
+};
+
+// The ways StompClient can reach a broker.
+enum StompTransportType
+{
+  STOMP_OVER_WEBSOCKET,   // the default: a WebSocket upgrade on an HTTP server
+  STOMP_OVER_TCP,         // raw STOMP on a TCP port, usually 61613
+  STOMP_OVER_UNIX         // raw STOMP on a Unix domain socket, for a local broker
+};
+
+// The outbound queue has two lanes. Frames in the control lane are written
+// ahead of anything waiting in the bulk lane, as soon as the write in progress
+// has finished, so they never wait behind a backlog of large SENDs.
+enum StompLane
+{
+  STOMP_LANE_BULK,
+  STOMP_LANE_CONTROL
+};
+
+// Socket options for latency-sensitive connections. The defaults leave the
+// socket as the system made it.
+struct StompSocketOptions
+{
+  bool noDelay       = false;   // TCP_NODELAY: do not hold small writes back
+  int  receiveBuffer = 0;       // SO_RCVBUF in bytes, 0 for the default
+  int  sendBuffer    = 0;       // SO_SNDBUF in bytes, 0 for the default
+  int  busyPoll      = 0;       // SO_BUSY_POLL in microseconds (Linux only)
+  bool quickAck      = false;   // TCP_QUICKACK, re-armed after every read (Linux only)
+};
+
+// What every transport has in common: the outbound queue and its buffer
+// pool, and the plumbing that tells the client what is going on. Each
+// transport supplies the connection set-up, the read loop and the low-level
+// writes; everything above that is shared.
+class transport : public std::enable_shared_from_this<transport>
+{
+ public:
+  // Constructor
+  transport( net::io_context &ioc, void (*errorFunction)( beast::error_code ec, char const *module ),
+	     websocketcallbacks *callbacks );
+
+  // Destructor
+  virtual ~transport();
+
+  // Start connecting. What host, port and path mean depends on the transport.
+  virtual void run( char const* host, char const* port, char const* path ) = 0;
+
+  // Close the connection once everything queued so far has been written.
+  void close();
+
+  // Drop the connection, or the attempt to make it, without waiting for the
+  // queue. The transport reports it as a disconnection.
+  void abort();
+
+  // Outbound frames are encoded straight into buffers taken from the pool.
+  // Hand the finished frame, terminator included, to send(); the buffer goes
+  // back to the pool once it has been written. Once a write has failed, the
+  // connection is closed and frames sent to it are dropped.
+  std::string acquireBuffer();
+  void        send( std::string&& frame, StompLane lane = STOMP_LANE_BULK );
+
+  // Hand back a buffer that was acquired but never sent.
+  void        recycleBuffer( std::string& buffer );
+
+  // How many bytes are queued but not yet written.
+  std::size_t queuedBytes();
+
+  // Set the socket options to apply once connected. Call before run().
+  void setSocketOptions( const StompSocketOptions& options );
+
+  // The biggest message to hold in memory whole; anything bigger drops the
+  // connection. 0 keeps the transport's own limit (16 MB for a WebSocket,
+  // none for a raw stream). Call before run().
+  void setReadMessageMax( std::size_t bytes );
+
+  // Switch to handing bytes to onReadSome() as they arrive, rather than whole
+  // frames to onRead(). This takes effect from the next read, so it is meant
+  // to be called from inside onRead(). Messages are never held whole in this
+  // mode, so the message limit no longer applies.
+  void setStreaming( bool streaming );
+
+ protected:
+  // Write one queued buffer, calling on_write when it is done.
+  virtual void write_frame( std::string& frame ) = 0;
+
+  // Shut the connection down once the queue has been written.
+  virtual void close_stream() = 0;
+
+  // Cancel whatever is in progress and close the socket, straight away.
+  virtual void abort_stream() = 0;
+
+  // For the transports to call as things happen.
+  void on_write( beast::error_code ec, std::size_t bytes_transferred );
+  void connected();
+  void disconnected( beast::error_code ec, char const *module );
+
+  // Apply the socket options to a freshly connected socket, and re-arm
+  // TCP_QUICKACK after a read (the kernel turns it off again by itself).
+  void tuneSocket( int fd, bool isTcp );
+  void rearmQuickAck( int fd );
+
+  StompSocketOptions socketOptions_;
+  bool               tcpSocket_ = false;
+
+  std::size_t        readMessageMax_ = 0;
+  std::atomic<bool>  streaming_{ false };
+
+  stomp_executor                       executor_;
+  void (*errorFunction_)( beast::error_code ec, char const *module );
+  websocketcallbacks                  *callbacks_;
+
+ private:
+  // Frames waiting to go out and the free list of buffers, both guarded by
+  // g_write. Once the writer picks up the waiting frames it owns them until
+  // they have been written.
+  std::mutex                           g_write;
+  std::vector<std::string>             messagesToSend;
+  std::vector<std::string>             bufferPool_;
+  std::size_t                          queuedBytes_   = 0;
+  bool                                 writing_       = false;
+  bool                                 closeRequested_ = false;
+  bool                                 writeFailed_   = false;
+  std::vector<std::string>             messagesInFlight_;
+  std::size_t                          nextToWrite_   = 0;
+
+  // The same again for the control lane. controlWaiting_ lets the writer see
+  // there is something in it without taking the lock after every frame.
+  std::vector<std::string>             controlToSend_;
+  std::vector<std::string>             controlInFlight_;
+  std::size_t                          nextControl_   = 0;
+  std::atomic<bool>                    controlWaiting_{ false };
+  bool                                 writingControl_ = false;
+  handler_memory                       startWriteMemory_;
+
+  // Pool sizing
+  static const std::size_t             POOLED_BUFFER_SIZE = 4096;
+  static const std::size_t             MAX_POOLED_BUFFERS = 64;
+
+  friend struct start_writer;
+  void write_next();
+  void wake_writer();
+};
@@ -0,0 +1,196 @@
+#include "TcpSession.h"
+#include "StompFrame.h"
+
+// Constructor
+template< class Stream >
+rawsession<Stream>::rawsession( net::io_context& ioc, void (*errorFunction)(beast::error_code, char const*),
+				websocketcallbacks *callbacks )
+  : transport( ioc, errorFunction, callbacks ), stream_( executor_ )
+{
+}
+
+template< class Stream >
+void rawsession<Stream>::start_reading()
+{
+  connected();
+  queueRead();
+}
+
+template< class Stream >
+void rawsession<Stream>::queueRead()
+{
+  stream_.async_read_some( buffer_.prepare( READ_SIZE ),
+			   beast::bind_front_handler( &rawsession::on_read, self() ) );
+}
+
+// The socket underneath each kind of stream
+static int nativeHandle( stomp_tcp_stream& stream )
+{
+  return stream.socket().native_handle();
+}
+
+static int nativeHandle( stomp_unix_socket& stream )
+{
+  return stream.native_handle();
+}
+
+// Pull every complete frame out of what has arrived so far
+template< class Stream >
+void rawsession<Stream>::on_read( beast::error_code ec, std::size_t bytes_transferred )
+{
+  if( ec )
+  {
+    return disconnected( ec, "read" );
+  }
+
+  rearmQuickAck( nativeHandle( stream_ ) );
+
+  buffer_.commit( bytes_transferred );
+  for( ;; )
+  {
+    net::mutable_buffer data  = buffer_.data();
+    char*               begin = static_cast<char*>( data.data() );
+
+    // When streaming, everything goes over as it is.
+    if( streaming_ )
+    {
+      if( data.size() > 0 )
+      {
+	callbacks_->onReadSome( begin, data.size() );
+      }
+      buffer_.consume( data.size() );
+      break;
+    }
+
+    std::size_t skip   = 0;
+    std::size_t length = findFrameEnd( begin, data.size(), skip );
+
+    // Heart-beats can go, but a partial frame has to wait for the rest.
+    if( length == 0 )
+    {
+      buffer_.consume( skip );
+    }
+
+    // A frame that is too big, whole or not, drops the connection.
+    std::size_t size = length == 0 ? buffer_.size() : length;
+    if( readMessageMax_ > 0 && size > readMessageMax_ )
+    {
+      abort_stream();
+      return disconnected( net::error::message_size, "read" );
+    }
+    if( length == 0 )
+    {
+      break;
+    }
+
+    callbacks_->onRead( begin + skip, length );
+    buffer_.consume( skip + length );
+  }
+
+  queueRead();
+}
+
+// Write one frame
+template< class Stream >
+void rawsession<Stream>::write_frame( std::string& frame )
+{
+  net::async_write( stream_, net::buffer( frame ), beast::bind_front_handler( &rawsession::on_write, self() ) );
+}
+
+// Closing a raw stream is just closing the socket.
+static void shutdownStream( stomp_tcp_stream& stream )
+{
+  beast::error_code ec;
+  stream.socket().shutdown( tcp::socket::shutdown_both, ec );
+  stream.close();
+}
+
+static void shutdownStream( stomp_unix_socket& stream )
+{
+  beast::error_code ec;
+  stream.shutdown( local_stream::socket::shutdown_both, ec );
+  stream.close( ec );
+}
+
+template< class Stream >
+void rawsession<Stream>::close_stream()
+{
+  shutdownStream( stream_ );
+}
+
+template< class Stream >
+void rawsession<Stream>::abort_stream()
+{
+  shutdownStream( stream_ );
+}
+
+template class rawsession<stomp_tcp_stream>;
+template class rawsession<stomp_unix_socket>;
+
+
+// Constructor
+tcpsession::tcpsession( net::io_context& ioc, void (*errorFunction)(beast::error_code, char const*),
+			websocketcallbacks *callbacks )
+  : rawsession( ioc, errorFunction, callbacks ), resolver_( executor_ )
+{
+}
+
+void tcpsession::run( char const* host, char const* port, char const* path )
+{
+  resolver_.async_resolve( host, port, beast::bind_front_handler( &tcpsession::on_resolve, self() ) );
+}
+
+void tcpsession::on_resolve( beast::error_code ec, tcp::resolver::results_type results )
+{
+  if( ec )
+  {
+    return disconnected( ec, "resolve" );
+  }
+
+  // Give the connection 30 seconds, as the WebSocket transport does.
+  stream_.expires_after( std::chrono::seconds( 30 ) );
+  stream_.async_connect( results, beast::bind_front_handler( &tcpsession::on_connect, self() ) );
+}
+
+void tcpsession::on_connect( beast::error_code ec, tcp::resolver::results_type::endpoint_type results )
+{
+  if( ec )
+  {
+    return disconnected( ec, "connect" );
+  }
+
+  stream_.expires_never();
+  tuneSocket( stream_.socket().native_handle(), true );
+  start_reading();
+}
+
+
+void tcpsession::abort_stream()
+{
+  resolver_.cancel();
+  rawsession::abort_stream();
+}
+
+
+// Constructor
+unixsession::unixsession( net::io_context& ioc, void (*errorFunction)(beast::error_code, char const*),
+			  websocketcallbacks *callbacks )
+  : rawsession( ioc, errorFunction, callbacks )
+{
+}
+
+void unixsession::run( char const* host, char const* port, char const* path )
+{
+  stream_.async_connect( local_stream::endpoint( path ), beast::bind_front_handler( &unixsession::on_connect, self() ) );
+}
+
+void unixsession::on_connect( beast::error_code ec )
+{
+  if( ec )
+  {
+    return disconnected( ec, "connect" );
+  }
+
+  tuneSocket( stream_.native_handle(), false );
+  start_reading();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// Imports from boost/asio
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/write.hpp>
+
+// The queue, buffer pool and callbacks shared by every transport
+#include "StompTransport.h"
+
+using local_stream      = net::local::stream_protocol;
+using stomp_unix_socket = local_stream::socket::rebind_executor<stomp_executor>::other;
+
+// STOMP straight over a byte stream, with no WebSocket framing. Frames are
+// found in the stream by their content-length or terminating NUL and handed
+// to the client straight out of the read buffer.
+template< class Stream >
+class rawsession : public transport
+{
+ public:
+  // Constructor
+  rawsession( net::io_context &ioc, void (*errorFunction)( beast::error_code ec, char const *module ),
+	      websocketcallbacks *callbacks );
+
+  void on_read( beast::error_code ec, std::size_t bytes_transferred );
+
+ protected:
+  void write_frame( std::string& frame );
+  void close_stream();
+  void abort_stream();
+
+  // Once connected, the transport calls this to tell the client and start reading.
+  void start_reading();
+  void queueRead();
+
+  std::shared_ptr<rawsession> self() { return std::static_pointer_cast<rawsession>( shared_from_this() ); }
+
+  Stream             stream_;
+  beast::flat_buffer buffer_;
+
+  // How much room to make in the buffer for each read.
+  static const std::size_t READ_SIZE = 64 * 1024;
+};
+
+// STOMP over plain TCP, as brokers usually offer on port 61613.
+class tcpsession : public rawsession<stomp_tcp_stream>
+{
+ public:
+  // Constructor
+  tcpsession( net::io_context &ioc, void (*errorFunction)( beast::error_code ec, char const *module ),
+	      websocketcallbacks *callbacks );
+
+  // The path is not used.
+  void run( char const* host, char const* port, char const* path );
+  void on_resolve( beast::error_code ec, tcp::resolver::results_type results );
+  void on_connect( beast::error_code ec, tcp::resolver::results_type::endpoint_type results );
+
+ protected:
+  void abort_stream();
+
+ private:
+  std::shared_ptr<tcpsession> self() { return std::static_pointer_cast<tcpsession>( shared_from_this() ); }
+
+  stomp_resolver resolver_;
+};
+
+// STOMP over a Unix domain socket, for a broker running alongside us.
+class unixsession : public rawsession<stomp_unix_socket>
+{
+ public:
+  // Constructor
+  unixsession( net::io_context &ioc, void (*errorFunction)( beast::error_code ec, char const *module ),
+	       websocketcallbacks *callbacks );
+
+  // The path is the socket's path; host and port are not used.
+  void run( char const* host, char const* port, char const* path );
+  void on_connect( beast::error_code ec );
+
+ private:
+  std::shared_ptr<unixsession> self() { return std::static_pointer_cast<unixsession>( shared_from_this() ); }
+};
@@ -1,7 +1,21 @@
 #pragma once
 
+#include <cstddef>
+
 class websocketcallbacks
 {
  public:
-  virtual void onRead( char const* message ) = 0;
+  virtual void onRead( char* message, std::size_t length ) = 0;
+
+  // In streaming mode the bytes are handed over as they arrive, instead of a
+  // frame at a time.
+  virtual void onReadSome( char* data, std::size_t length ) {}
+
+  // The connection is up and ready for frames.
+  virtual void onConnected() {}
+
+  // The connection has gone away (or could not be made), or the write queue
+  // has just emptied.
+  virtual void onDisconnect() {}
+  virtual void onWritable() {}
 };
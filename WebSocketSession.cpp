@@ -4,8 +4,7 @@
 // Constructor
 session::session( net::io_context& ioc, void (*errorFunction)(beast::error_code, char const*) ,
 		  websocketcallbacks *callbacks )
-  : resolver_( net::make_strand( ioc ) ), ws_( net::make_strand( ioc ) ),
-    errorFunction_( errorFunction ), callbacks_( callbacks )
+  : transport( ioc, errorFunction, callbacks ), resolver_( executor_ ), ws_( executor_ )
 {
 }
 
@@ -25,7 +24,7 @@ void session::run( char const *host, char const *port, char const *path )
   //std::cout << "Starting to resolve " << host << " at port " << port << " with path " << path << std::endl;
     
   // Look up the domain
-  resolver_.async_resolve( host, port, beast::bind_front_handler( &session::on_resolve, shared_from_this() ) );
+  resolver_.async_resolve( host, port, beast::bind_front_handler( &session::on_resolve, self() ) );
   
   //std::cout << "Finished sending asynchronous resolve request" << std::endl;
 }
@@ -37,7 +36,7 @@ void session::on_resolve( beast::error_code ec, tcp::resolver::results_type resu
   
   if( ec )
   {
-    return (*errorFunction_)( ec, "resolve" );
+    return disconnected( ec, "resolve" );
   }
 
   // Set the timeout to be 30 seconds.
@@ -46,7 +45,7 @@ void session::on_resolve( beast::error_code ec, tcp::resolver::results_type resu
   // Make the IP connection
   //std::cout << "Connecting to server " << std::endl;
   
-  beast::get_lowest_layer( ws_ ).async_connect( results, beast::bind_front_handler( &session::on_connect, shared_from_this()));
+  beast::get_lowest_layer( ws_ ).async_connect( results, beast::bind_front_handler( &session::on_connect, self()));
 }
 
 // Prepared the connection
@@ -56,15 +55,24 @@ void session::on_connect( beast::error_code ec, tcp::resolver::results_type::end
   
   if( ec )
   {
-    return (*errorFunction_)( ec, "connect" );
+    return disconnected( ec, "connect" );
   }
 
   // Turn off the timeout on the tcp_stream
   beast::get_lowest_layer( ws_ ).expires_never();
 
+  // Tune the socket
+  tuneSocket( beast::get_lowest_layer( ws_ ).socket().native_handle(), true );
+
   // Set the suggested timeout on the websocket
   ws_.set_option( websocket::stream_base::timeout::suggested( beast::role_type::client ) );
 
+  // Set the largest message we will take
+  if( readMessageMax_ > 0 )
+  {
+    ws_.read_message_max( readMessageMax_ );
+  }
+
   // Change the name of the user agent
   ws_.set_option( websocket::stream_base::decorator( [](websocket::request_type& req)
 		{
@@ -72,45 +80,59 @@ void session::on_connect( beast::error_code ec, tcp::resolver::results_type::end
 		}));
 
   // Perform the websocket "upgrade" dance and handshake.
-  ws_.async_handshake( host_, path_, beast::bind_front_handler( &session::on_handshake, shared_from_this() ) );
+  ws_.async_handshake( host_, path_, beast::bind_front_handler( &session::on_handshake, self() ) );
 }
 
 void session::on_handshake( beast::error_code ec )
 {
   if( ec )
   {
-    return (*errorFunction_)( ec, "handshake" );
+    return disconnected( ec, "handshake" );
   }
 
   // We are a web socket!
-  std::unique_lock<std::mutex> locker( g_connection );
-  g_connectioncheck.notify_one();
+  connected();
 
   //std::cout << "Connection is ready: notifying the client" << std::endl;
   
   // Queue up an asynchronous read.
-  ws_.async_read( buffer_, beast::bind_front_handler( &session::on_read, shared_from_this() ) );
+  queue_read();
 }
 
-
-// Clean up after a write operation
-void session::on_write( beast::error_code ec, std::size_t bytes_transferred )
+// Read the next whole message, or whatever has arrived if we are streaming.
+void session::queue_read()
 {
-  //std::cout << "Sucessfully completed write operation" << std::endl;
-  // Clean up the buffer
-  boost::ignore_unused( bytes_transferred );
-
-  if( ec )
+  if( streaming_ )
+  {
+    // Messages are not held whole any more, so there is nothing to limit.
+    ws_.read_message_max( 0 );
+    ws_.async_read_some( buffer_, READ_SIZE, beast::bind_front_handler( &session::on_read_some, self() ) );
+  }
+  else
   {
-    return (*errorFunction_)( ec, "write" );
+    ws_.async_read( buffer_, beast::bind_front_handler( &session::on_read, self() ) );
   }
+}
+
 
-  // Release the semaphore lock
-  std::unique_lock<std::mutex> locker( g_write );
-  g_writecheck.notify_one();
+// Write one frame as a WebSocket message
+void session::write_frame( std::string& frame )
+{
+  ws_.async_write( net::buffer( frame ), beast::bind_front_handler( &session::on_write, self() ) );
 }
 
-typedef void (session::*queueReadFunction)();
+// Do the WebSocket closing handshake
+void session::close_stream()
+{
+  ws_.async_close( websocket::close_code::normal, beast::bind_front_handler( &session::on_close, self() ) );
+}
+
+// Give up on the connection, wherever it has got to
+void session::abort_stream()
+{
+  resolver_.cancel();
+  beast::get_lowest_layer( ws_ ).close();
+}
 
 // Clean up after a read operation
 void session::on_read( beast::error_code ec, std::size_t bytes_transferred )
@@ -121,61 +143,44 @@ void session::on_read( beast::error_code ec, std::size_t bytes_transferred )
 
   if( ec )
   {
-    return (*errorFunction_)( ec, "read" );
+    return disconnected( ec, "read" );
   }
 
-  // Get the data
-  std::string serverString = beast::buffers_to_string( buffer_.data() );
-  const char* serverText = serverString.c_str();
+  rearmQuickAck( beast::get_lowest_layer( ws_ ).socket().native_handle() );
 
-  // Clear out the buffer
-  buffer_.clear();
+  // Hand the message to the client straight out of the read buffer. This has
+  // to happen before the next read is queued, since that may write into the
+  // buffer straight away.
+  net::mutable_buffer data = buffer_.data();
+  callbacks_->onRead( static_cast<char*>( data.data() ), data.size() );
 
-  // Queue up another read and ...
-  ws_.async_read( buffer_, beast::bind_front_handler( &session::on_read, shared_from_this() ));
+  // Clear out the buffer, keeping its capacity for the next message, and ...
+  buffer_.clear();
 
-  // ... handle the message
-  callbacks_->onRead( serverText );
+  // ... queue up another read.
+  queue_read();
 }
 
-/*
-void session::queueRead()
-{
-  ws_.async_read( buffer_, beast::bind_front_handler( &session::on_read, shared_from_this() ));
-}
-*/
-
-void session::on_close( beast::error_code ec )
+// Hand over part of a message, as it arrives
+void session::on_read_some( beast::error_code ec, std::size_t bytes_transferred )
 {
   if( ec )
   {
-    return (*errorFunction_)( ec, "close" );
+    return disconnected( ec, "read" );
   }
-}
 
-// External APIs
-void session::send( char const* newText )
-{
-  std::cout << "Writing new text:\n" << std::string( newText ) << std::endl;
+  rearmQuickAck( beast::get_lowest_layer( ws_ ).socket().native_handle() );
 
-  // Add the '\0' to end the frame.  
-  std::string textToSend( newText );
-  textToSend.push_back( '\0' );
-  textToSend.push_back( '\n' );
-
-  // Do the write and block until the write is finished.
-  ws_.async_write( net::buffer( textToSend ), beast::bind_front_handler( &session::on_write, shared_from_this() ) );
-
-  // This causes the calling thread to block until the write is done.
-  std::unique_lock<std::mutex> locker( g_write );
-  g_writecheck.wait( locker );
+  net::mutable_buffer data = buffer_.data();
+  callbacks_->onReadSome( static_cast<char*>( data.data() ), data.size() );
+  buffer_.consume( data.size() );
+  queue_read();
 }
 
-void session::close()
+void session::on_close( beast::error_code ec )
 {
-  std::cout << "WebSocketSession: closing WebSocket" << std:: endl;
-  ws_.async_close( websocket::close_code::normal, beast::bind_front_handler( &session::on_close, shared_from_this() ) );
+  if( ec )
+  {
+    return (*errorFunction_)( ec, "close" );
+  }
 }
-    
-      
-						    
@@ -1,32 +1,16 @@
 #pragma once
 
-// Standard includes
-#include <string>
-#include <cstdlib>
-#include <functional>
-#include <iostream>
-#include <memory> 
-#include <thread>
-#include <condition_variable>
-#include <mutex>
-#include <deque>
-
 // Imports from boost/beast
-#include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
-#include <boost/asio/strand.hpp>
 
-// WebSockets
-#include "WebSocketCallbacks.h"
+// The queue, buffer pool and callbacks shared by every transport
+#include "StompTransport.h"
 
-// Declare the namespaces
-namespace beast     = boost::beast;
 namespace http      = beast::http;
 namespace websocket = beast::websocket;
-namespace net       = boost::asio;
-using     tcp       = boost::asio::ip::tcp;
 
-class session : public std::enable_shared_from_this<session>
+// STOMP over a WebSocket.
+class session : public transport
 {
  public:
   // Constructor
@@ -40,31 +24,28 @@ class session : public std::enable_shared_from_this<session>
   void on_resolve( beast::error_code ec, tcp::resolver::results_type results );
   void on_connect( beast::error_code ec, tcp::resolver::results_type::endpoint_type results );
   void on_handshake( beast::error_code ec );
-  void on_write( beast::error_code ec, std::size_t bytes_transferred );
   void on_read(  beast::error_code ec, std::size_t bytes_transferred );
+  void on_read_some( beast::error_code ec, std::size_t bytes_transferred );
   void on_close( beast::error_code ec );
-  void queueRead();
-
-  // External APIs
-  void send( char const* newText );
-  void close();
 
-  // These are used to cause the client to wait for the connection to be made.
-  std::mutex              g_connection;
-  std::condition_variable g_connectioncheck;
-  std::mutex              g_messages;
-  std::mutex              g_write;
-  std::condition_variable g_writecheck;
+ protected:
+  void write_frame( std::string& frame );
+  void close_stream();
+  void abort_stream();
 
  private:
-  tcp::resolver                        resolver_;
-  websocket::stream<beast::tcp_stream> ws_;
+  std::shared_ptr<session> self() { return std::static_pointer_cast<session>( shared_from_this() ); }
+
+  stomp_resolver                       resolver_;
+  websocket::stream<stomp_tcp_stream>  ws_;
   beast::flat_buffer                   buffer_;
   std::string                          host_;
   std::string                          path_;
-  void (*errorFunction_)( beast::error_code ec, char const *module );
-  websocketcallbacks                  *callbacks_;
-  std::deque< std::string>             messagesToSend;
+
+  // How much to read at a time when streaming
+  static const std::size_t READ_SIZE = 64 * 1024;
+
+  void queue_read();
 };
   
 
@@ -0,0 +1,120 @@
+// Checks that sending and receiving frames, once the connection has warmed
+// up, does not touch the heap.
+
+#include "StompClient.h"
+#include "StompFakeBroker.h"
+#include "StompTest.h"
+
+#include <atomic>
+#include <new>
+
+// Every allocation made while counting, except the broker's.
+static std::atomic<bool>        counting{ false };
+static std::atomic<std::size_t> allocations{ 0 };
+static std::thread::id          brokerThread;
+
+void* operator new( std::size_t size )
+{
+  if( counting && std::this_thread::get_id() != brokerThread )
+  {
+    ++allocations;
+  }
+  void* pointer = std::malloc( size > 0 ? size : 1 );
+  if( pointer == NULL )
+  {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete( void* pointer ) noexcept
+{
+  std::free( pointer );
+}
+
+void operator delete( void* pointer, std::size_t ) noexcept
+{
+  std::free( pointer );
+}
+
+static std::atomic<int> received{ 0 };
+
+void onFrame( const StompFrame& frame, void* context )
+{
+  ++received;
+}
+
+// Wait for the handler to have been called at least count times.
+static bool waitForFrames( int count )
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+  while( received < count && std::chrono::steady_clock::now() < deadline )
+  {
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+  return received >= count;
+}
+
+// A burst of MESSAGE frames, sent as one write.
+static std::string messages( int count )
+{
+  std::string burst;
+  for( int i = 0; i < count; i++ )
+  {
+    burst += "MESSAGE\nsubscription:1\nmessage-id:" + std::to_string( i ) + "\ndestination:/topic/t\n\nbody";
+    burst += '\0';
+  }
+  burst.pop_back();
+  return burst;
+}
+
+int main( int argc, char *argv[] )
+{
+  StompFakeBroker broker;
+  brokerThread = broker.thread();
+
+  StompClient client;
+  client.setTransport( STOMP_OVER_TCP );
+  STOMP_CHECK( client.connect( "127.0.0.1", broker.port(), "/", NULL, NULL ) );
+  client.subscribe( 1, "/topic/t", "auto", onFrame );
+  STOMP_CHECK( broker.waitFor( "SUBSCRIBE" ) );
+
+  // Sending: warm the buffer pool up first.
+  const int SENDS = 4000;
+  for( int i = 0; i < SENDS; i++ )
+  {
+    client.send( "/topic/t", "text/plain", "body" );
+  }
+  STOMP_CHECK( broker.waitFor( "SEND", SENDS ) );
+
+  counting = true;
+  for( int i = 0; i < SENDS; i++ )
+  {
+    client.send( "/topic/t", "text/plain", "body" );
+    if( i % 64 == 63 )
+    {
+      // Let the writer catch up, so the queue stays within the pool.
+      broker.waitFor( "SEND", SENDS + i + 1 );
+    }
+  }
+  STOMP_CHECK( broker.waitFor( "SEND", 2 * SENDS ) );
+  counting = false;
+  std::cerr << "sending " << SENDS << " frames: " << allocations << " allocations" << std::endl;
+  STOMP_CHECK( allocations == 0 );
+
+  // Receiving: the same again.
+  const int MESSAGES = 4000;
+  std::string burst = messages( MESSAGES );
+  broker.send( burst );
+  STOMP_CHECK( waitForFrames( MESSAGES ) );
+
+  allocations = 0;
+  counting    = true;
+  broker.send( burst );
+  STOMP_CHECK( waitForFrames( 2 * MESSAGES ) );
+  counting = false;
+  std::cerr << "receiving " << MESSAGES << " frames: " << allocations << " allocations" << std::endl;
+  STOMP_CHECK( allocations == 0 );
+
+  return stompTestResult();
+}
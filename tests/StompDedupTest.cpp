@@ -0,0 +1,57 @@
+// Checks on dropping redelivered messages.
+
+#include "StompClient.h"
+#include "StompFakeBroker.h"
+#include "StompTest.h"
+
+#include <atomic>
+
+static std::atomic<int> handled{ 0 };
+
+void onMessage( const StompFrame& frame, void* context )
+{
+  ++handled;
+}
+
+int main( int argc, char *argv[] )
+{
+  StompFakeBroker broker;
+  StompClient     client;
+  client.setTransport( STOMP_OVER_TCP );
+  STOMP_CHECK( client.connect( "127.0.0.1", broker.port(), "/", NULL, NULL ) );
+
+  // Under "client" an ACK is cumulative; under "client-individual" it is not.
+  client.setDeduplication( 1, 16 );
+  client.setDeduplication( 2, 16 );
+  client.subscribe( 1, "/queue/cumulative", "client", onMessage );
+  client.subscribe( 2, "/queue/individual", "client-individual", onMessage );
+  STOMP_CHECK( broker.waitFor( "SUBSCRIBE", 2 ) );
+
+  // Each message, then its redelivery.
+  const char* cumulative = "MESSAGE\nsubscription:1\nmessage-id:a\nack:ack-a\ndestination:/queue/cumulative\n\nbody";
+  const char* individual = "MESSAGE\nsubscription:2\nmessage-id:b\nack:ack-b\ndestination:/queue/individual\n\nbody";
+  broker.send( cumulative );
+  broker.send( cumulative );
+  broker.send( individual );
+  broker.send( individual );
+
+  // The repeat on the "client-individual" subscription is acknowledged for
+  // us. ACKs go out in order, so had the "client" one been acknowledged too,
+  // its ACK would have come first.
+  STOMP_CHECK( broker.waitFor( "ACK" ) );
+  std::vector<std::string> acks;
+  for( const std::string& frame : broker.frames() )
+  {
+    if( frame.compare( 0, 4, "ACK\n" ) == 0 )
+    {
+      acks.push_back( frame );
+    }
+  }
+  STOMP_CHECK( acks.size() == 1 );
+  STOMP_CHECK( !acks.empty() && acks.front().find( "\nid:ack-b\n" ) != std::string::npos );
+
+  // Neither repeat reaches the handler.
+  STOMP_CHECK( handled == 2 );
+
+  return stompTestResult();
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sockets
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Just enough of a broker to test the client against, speaking raw STOMP
+// over TCP on a port of the loopback interface. It takes one connection,
+// answers CONNECT with CONNECTED and a DISCONNECT asking for a receipt with
+// RECEIPT, and keeps every frame it is sent for the test to look at. The
+// test sends whatever else it wants the client to see with send().
+class StompFakeBroker
+{
+ public:
+  StompFakeBroker()
+  {
+    listener_ = socket( AF_INET, SOCK_STREAM, 0 );
+    sockaddr_in address;
+    std::memset( &address, 0, sizeof( address ) );
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port        = 0;
+    bind( listener_, reinterpret_cast<sockaddr*>( &address ), sizeof( address ) );
+    listen( listener_, 1 );
+
+    socklen_t length = sizeof( address );
+    getsockname( listener_, reinterpret_cast<sockaddr*>( &address ), &length );
+    port_ = std::to_string( ntohs( address.sin_port ) );
+
+    worker_ = std::thread( &StompFakeBroker::run, this );
+  }
+
+  ~StompFakeBroker()
+  {
+    shutdown( listener_, SHUT_RDWR );
+    {
+      std::unique_lock<std::mutex> locker( g_frames );
+      if( connection_ >= 0 )
+      {
+	shutdown( connection_, SHUT_RDWR );
+      }
+    }
+    worker_.join();
+    close( listener_ );
+    if( connection_ >= 0 )
+    {
+      close( connection_ );
+    }
+  }
+
+  const char* port() const { return port_.c_str(); }
+
+  // The broker's own thread, for tests that need to tell its work apart.
+  std::thread::id thread() const { return worker_.get_id(); }
+
+  // Send a frame to the client. The terminating NUL is added here, without
+  // copying the frame, so that sending does not allocate.
+  void send( const std::string& frame )
+  {
+    std::unique_lock<std::mutex> locker( g_frames );
+    ::send( connection_, frame.data(), frame.size(), MSG_NOSIGNAL | MSG_MORE );
+    ::send( connection_, "", 1, MSG_NOSIGNAL );
+  }
+
+  // Wait for count frames with the given command to have come in. Returns
+  // false if they do not within the timeout.
+  bool waitFor( const char* command, std::size_t count = 1,
+		std::chrono::milliseconds timeout = std::chrono::seconds( 5 ) )
+  {
+    std::unique_lock<std::mutex> locker( g_frames );
+    return g_framescheck.wait_for( locker, timeout, [&]() { return countLocked( command ) >= count; } );
+  }
+
+  // How many frames with the given command have come in.
+  std::size_t count( const char* command )
+  {
+    std::unique_lock<std::mutex> locker( g_frames );
+    return countLocked( command );
+  }
+
+  // Every frame that has come in, in order, without its terminator and with
+  // its line endings made LF.
+  std::vector<std::string> frames()
+  {
+    std::unique_lock<std::mutex> locker( g_frames );
+    return frames_;
+  }
+
+ private:
+  static bool isCommand( const std::string& frame, const char* command )
+  {
+    std::size_t length = std::strlen( command );
+    return frame.compare( 0, length, command ) == 0 && frame.size() > length && frame[ length ] == '\n';
+  }
+
+  std::size_t countLocked( const char* command )
+  {
+    std::size_t found = 0;
+    for( const std::string& frame : frames_ )
+    {
+      found += isCommand( frame, command ) ? 1 : 0;
+    }
+    return found;
+  }
+
+  // The value of a header in a frame, or an empty string.
+  static std::string header( const std::string& frame, const char* name )
+  {
+    std::string key = std::string( "\n" ) + name + ":";
+    std::size_t start = frame.find( key );
+    if( start == std::string::npos )
+    {
+      return std::string();
+    }
+    start += key.size();
+    return frame.substr( start, frame.find( '\n', start ) - start );
+  }
+
+  void run()
+  {
+    int connection = accept( listener_, NULL, NULL );
+    if( connection < 0 )
+    {
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> locker( g_frames );
+      connection_ = connection;
+    }
+
+    std::string pending;
+    char        buffer[ 4096 ];
+    for( ;; )
+    {
+      ssize_t received = recv( connection, buffer, sizeof( buffer ), 0 );
+      if( received <= 0 )
+      {
+	return;
+      }
+      pending.append( buffer, received );
+
+      std::size_t end;
+      while( ( end = pending.find( '\0' ) ) != std::string::npos )
+      {
+	// Heart-beats, and the EOLs the client may put between frames
+	std::size_t start = pending.find_first_not_of( "\r\n" );
+	std::string frame = start < end ? pending.substr( start, end - start ) : std::string();
+	pending.erase( 0, end + 1 );
+	if( frame.empty() )
+	{
+	  continue;
+	}
+
+	// The client ends its lines with CRLF; the tests only look for LF.
+	frame.erase( std::remove( frame.begin(), frame.end(), '\r' ), frame.end() );
+
+	if( isCommand( frame, "CONNECT" ) || isCommand( frame, "STOMP" ) )
+	{
+	  send( "CONNECTED\nversion:1.2\n\n" );
+	}
+	else if( isCommand( frame, "DISCONNECT" ) && !header( frame, "receipt" ).empty() )
+	{
+	  send( "RECEIPT\nreceipt-id:" + header( frame, "receipt" ) + "\n\n" );
+	}
+
+	std::unique_lock<std::mutex> locker( g_frames );
+	frames_.push_back( std::move( frame ) );
+	g_framescheck.notify_all();
+      }
+    }
+  }
+
+  int                      listener_   = -1;
+  std::string              port_;
+  std::thread              worker_;
+
+  // The connection and the frames that have come in on it, guarded by
+  // g_frames.
+  std::mutex               g_frames;
+  std::condition_variable  g_framescheck;
+  int                      connection_ = -1;
+  std::vector<std::string> frames_;
+};
@@ -0,0 +1,23 @@
+// Checks on what each policy set allows.
+
+#include "StompClient.h"
+#include "StompTest.h"
+
+int main( int argc, char *argv[] )
+{
+  // Conflation runs handlers on a thread of their own, which the inline
+  // executor's unlocked state cannot allow.
+  {
+    StompLeanClient lean;
+    STOMP_CHECK( !lean.setConflation( 1, CONFLATE_BY_HEADER, "symbol", 16 ) );
+  }
+
+  // The default policies allow it, and turning it off again.
+  {
+    StompClient client;
+    STOMP_CHECK( client.setConflation( 1, CONFLATE_BY_HEADER, "symbol", 16 ) );
+    STOMP_CHECK( client.setConflation( 1, CONFLATE_BY_HEADER, "symbol", 0 ) );
+  }
+
+  return stompTestResult();
+}
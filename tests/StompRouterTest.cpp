@@ -0,0 +1,51 @@
+// Checks on routing messages from one subscription to local handlers.
+
+#include "StompRouter.h"
+#include "StompFakeBroker.h"
+#include "StompTest.h"
+
+#include <atomic>
+
+static std::atomic<int> calls{ 0 };
+
+void onRouted( const StompFrame& frame, void* context )
+{
+  ++calls;
+}
+
+// Wait for the handler to have been called at least count times.
+static bool waitForCalls( int count )
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 5 );
+  while( calls < count && std::chrono::steady_clock::now() < deadline )
+  {
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+  return calls >= count;
+}
+
+int main( int argc, char *argv[] )
+{
+  StompFakeBroker broker;
+  StompClient     client;
+  client.setTransport( STOMP_OVER_TCP );
+  STOMP_CHECK( client.connect( "127.0.0.1", broker.port(), "/", NULL, NULL ) );
+
+  StompRouter router( client );
+  router.attach( 1, "/topic/#", "auto" );
+  STOMP_CHECK( broker.waitFor( "SUBSCRIBE" ) );
+
+  // A pattern with two "#" matches /topic/x.y three ways, but is one route.
+  router.route( "/topic/#/#", onRouted );
+  broker.send( "MESSAGE\nsubscription:1\nmessage-id:1\ndestination:/topic/x.y\n\nfirst" );
+
+  // Another message behind it, so that once it is in, any repeat calls for
+  // the first have been made.
+  int marker = router.route( "/marker", onRouted );
+  broker.send( "MESSAGE\nsubscription:1\nmessage-id:2\ndestination:/marker\n\nsecond" );
+  STOMP_CHECK( waitForCalls( 2 ) );
+  STOMP_CHECK( calls == 2 );
+  router.unroute( marker );
+
+  return stompTestResult();
+}
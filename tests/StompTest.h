@@ -0,0 +1,34 @@
+#pragma once
+
+// What the tests have in common. Each test is a program of its own, built
+// against the library sources and run with no arguments, e.g.
+//
+//   g++ -std=c++17 -I.. StompPolicyTest.cpp $(ls ../*.cpp | grep -v -e Chat -e StompAPI -e StompGlib) -pthread
+//
+// It prints what failed and exits non-zero if anything did.
+
+// Standard includes
+#include <cstdlib>
+#include <iostream>
+
+static int stompTestFailures = 0;
+
+#define STOMP_CHECK( condition )					\
+  do									\
+  {									\
+    if( !( condition ) )						\
+    {									\
+      std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " << #condition << std::endl; \
+      ++stompTestFailures;						\
+    }									\
+  } while( 0 )
+
+static int stompTestResult()
+{
+  if( stompTestFailures > 0 )
+  {
+    std::cerr << stompTestFailures << " check(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}